@@ -0,0 +1,27 @@
+
+#ifndef AUTOTUNE_IS_DEF
+#define AUTOTUNE_IS_DEF
+
+// Réglage automatique (option --autotune)
+//
+// Des exécutions courtes du programme lui-même, sans affichage, comparent
+// successivement les variantes, les valeurs de GRAIN, les politiques
+// d'ordonnancement OpenMP, le nombre de threads et, pour OpenCL, la taille
+// des groupes de travail (TILEX x TILEY). Chaque étape ne conserve que les
+// meilleures configurations de la précédente. Les variantes dont les
+// empreintes (--validate, --golden) diffèrent de celles de leur variante de
+// référence sont écartées avant d'être mesurées : seq par défaut, ou celle
+// qu'indique <noyau>_reference (variante), NULL si aucune ne calcule
+// exactement comme elle. Le résultat est enregistré dans un profil propre à
+// la machine ($AUTOTUNE_PROFILE, par défaut ~/.2Dcomp-autotune), indexé par
+// la topologie, le noyau, DIM et l'argument de dessin. Une exécution
+// ultérieure avec -v auto recharge ce réglage.
+
+extern unsigned do_autotune;
+
+int autotune_run (char *progname);
+
+// Remplace la variante « auto » par le réglage enregistré
+void autotune_load (void);
+
+#endif
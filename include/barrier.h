@@ -0,0 +1,41 @@
+
+#ifndef BARRIER_IS_DEF
+#define BARRIER_IS_DEF
+
+#include <stdatomic.h>
+
+// Barrières entre threads : attente active puis futex
+typedef enum
+{
+  BARRIER_AUTO,          // choix selon le nombre de threads
+  BARRIER_CENTRAL,       // compteur central
+  BARRIER_TREE,          // arbre de combinaison (arité 4)
+  BARRIER_DISSEMINATION  // log2(n) tours d'échanges deux à deux
+} barrier_kind_t;
+
+struct barrier_slot;
+
+typedef struct
+{
+  barrier_kind_t kind;
+  unsigned nb_threads;
+  unsigned rounds;
+  atomic_uint count;
+  atomic_uint release;
+  atomic_uint sleeping;
+  struct barrier_slot *slot;
+} barrier_t;
+
+// kind vaut BARRIER_AUTO sauf si la variable BARRIER vaut central, tree ou
+// dissemination
+int barrier_init (barrier_t *b, unsigned nb_threads);
+void barrier_destroy (barrier_t *b);
+
+// me est le numéro du thread appelant, entre 0 et nb_threads - 1
+void barrier_wait (barrier_t *b, unsigned me);
+
+// Barrière au cours de laquelle un seul thread appelle f avant de libérer
+// les autres
+void barrier_single (barrier_t *b, unsigned me, void (*f) (void));
+
+#endif
@@ -19,10 +19,15 @@ extern void_func_t the_init;
 extern draw_func_t the_draw;
 extern void_func_t the_finalize;
 extern int_func_t the_compute;
+extern int_func_t the_refine;
+extern void_func_t the_refresh_img;
 
 extern unsigned opencl_used;
 extern char *version;
 
 unsigned get_nb_cores (void);
+void pin_current_thread (unsigned c);
+void unpin_current_thread (void);
+void *bind_it (char *kernel, char *s, char *version, int print_error);
 
 #endif
@@ -14,6 +14,7 @@
 //      't' -- threads
 //      'o' -- OpenCL
 //      'm' -- monitoring
+//      'p' -- performance counters
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -4,11 +4,14 @@
 
 extern unsigned display;
 extern unsigned vsync;
+extern unsigned pbo_enabled;
 extern unsigned refresh_rate;
+extern unsigned frame_budget;
 extern unsigned do_first_touch;
 extern int max_iter;
 extern char *pngfile;
 extern char *draw_param;
+extern char *view_param;
 
 extern unsigned DIM;
 extern unsigned GRAIN;
@@ -11,6 +11,9 @@ typedef uint8_t Uint8;
 #endif
 
 #include "global.h"
+#include "trace.h"
+
+#include <stddef.h>
 
 void graphics_init ();
 void graphics_share_texture_buffers (void);
@@ -18,6 +21,9 @@ void graphics_refresh (void);
 void graphics_dump_image_to_file (char *filename);
 void graphics_clean (void);
 int graphics_display_enabled (void);
+void graphics_redraw (void);
+void graphics_view_zoom (int x, int y, float factor);
+void graphics_view_pan (int dx, int dy);
 
 extern Uint32 *restrict image, *restrict alt_image;
 
@@ -29,12 +35,37 @@ static inline Uint32 *img_cell (Uint32 *i, int l, int c)
 #define cur_img(y, x) (*img_cell (image, (y), (x)))
 #define next_img(y, x) (*img_cell (alt_image, (y), (x)))
 
+// Suivi des tuiles modifiées : un noyau qui signale chacune des tuiles qu'il
+// calcule permet au rendu de ne renvoyer au GPU que les zones qui ont changé
+// depuis le dernier rafraîchissement (les autres noyaux provoquent un envoi
+// complet de l'image).
+#define DIRTY_TILE 32
+
+extern unsigned char *dirty_map;
+extern unsigned dirty_dim, dirty_tracking;
+
+static inline void graphics_report_tile (int i_d, int j_d, int i_f, int j_f,
+                                         int changed)
+{
+  if (dirty_map == NULL)
+    return;
+
+  dirty_tracking = 1;
+
+  if (changed)
+    for (int i = i_d / DIRTY_TILE; i <= i_f / DIRTY_TILE; i++)
+      for (int j = j_d / DIRTY_TILE; j <= j_f / DIRTY_TILE; j++)
+        dirty_map[i * dirty_dim + j] = 1;
+}
+
 static inline void swap_images (void)
 {
   Uint32 *tmp = image;
 
   image     = alt_image;
   alt_image = tmp;
+
+  trace_next_iteration ();
 }
 
 #endif
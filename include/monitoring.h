@@ -1,6 +1,7 @@
 #ifndef MONITORING_IS_DEF
 #define MONITORING_IS_DEF
 
+#include "trace.h"
 
 extern unsigned do_monitoring;
 
@@ -11,6 +12,20 @@ void monitoring_begin ();
 void monitoring_end ();
 void __monitoring_add_tile (int x, int y, int width, int height, int color);
 
-#define monitoring_add_tile(x,y,w,h,c) do { if (do_monitoring) __monitoring_add_tile ((x), (y), (w), (h), (c)); } while(0)
+// Une tuile est encadrée par monitoring_start_tile et monitoring_end_tile,
+// appelées par le thread qui la calcule ; who sert de couleur au monitoring
+static inline void monitoring_start_tile (void)
+{
+  if (trace_enabled)
+    trace_tile_start = trace_now ();
+}
+
+static inline void monitoring_end_tile (int x, int y, int w, int h, int who)
+{
+  if (trace_enabled)
+    trace_record (x, y, w, h, who);
+}
+
+#define monitoring_add_tile(x,y,w,h,c) do { monitoring_start_tile (); monitoring_end_tile ((x), (y), (w), (h), (c)); } while(0)
 
 #endif
@@ -0,0 +1,28 @@
+
+#ifndef PERF_IS_DEF
+#define PERF_IS_DEF
+
+// Compteurs matériels (option --perf-counters cycles,instructions,...)
+//
+// Chaque thread de calcul ouvre son propre groupe de compteurs avec
+// perf_event_open. Les groupes sont activés juste avant chaque appel à
+// the_compute et lus juste après ; le bilan par variante (IPC, défauts de
+// cache par cellule, débit mémoire estimé) est affiché à la fin. Si les
+// compteurs ne sont pas disponibles (conteneur, perf_event_paranoid, autre
+// système que Linux), un avertissement est affiché et la mesure est ignorée.
+
+extern char *perf_param;
+extern unsigned perf_enabled;
+
+void perf_init (void);
+void perf_finalize (void);
+
+// Les threads qui ne font pas partie de l'équipe OpenMP s'enregistrent
+// eux-mêmes ; un thread « transient » disparaît à la fin de l'appel à
+// the_compute qui l'a créé
+void perf_register_thread (int transient);
+
+void perf_start (void);
+void perf_stop (unsigned nb_iter);
+
+#endif
@@ -0,0 +1,37 @@
+
+#ifndef PHASES_IS_DEF
+#define PHASES_IS_DEF
+
+#include <stdint.h>
+
+// Durée de chaque phase de la boucle principale (option --phases <fichier>)
+//
+// Les durées sont mesurées avec l'horloge monotone et rangées dans des
+// histogrammes log-linéaires (à la HDR Histogram : 32 sous-intervalles par
+// puissance de 2, soit une erreur relative inférieure à 3 %). À la fin, les
+// percentiles de chaque phase sont affichés et l'histogramme complet est
+// écrit au format JSON.
+
+enum
+{
+  PHASE_EVENTS,      // traitement des événements SDL
+  PHASE_COMPUTE,     // the_compute (l'échange des images en fait partie)
+  PHASE_SYNC,        // attente de la fin des calculs OpenCL
+  PHASE_REFRESH_IMG, // the_refresh_img
+  PHASE_RENDER,      // graphics_refresh (envoi de l'image, présentation)
+  PHASE_REFINE,      // the_refine (affinage progressif)
+  PHASE_FRAME,       // un tour complet de boucle
+  NB_PHASES
+};
+
+extern char *phases_file;
+
+uint64_t phases_now (void);
+
+// Enregistre la durée écoulée depuis start et renvoie la date courante,
+// ce qui permet d'enchaîner les phases
+uint64_t phases_record (int phase, uint64_t start);
+
+void phases_finalize (void);
+
+#endif
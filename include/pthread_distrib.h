@@ -1,24 +1,43 @@
-
 #ifndef PTHREAD_DISTRIB
 #define PTHREAD_DISTRIB
 
 #include <pthread.h>
+#include <stdatomic.h>
+
+// Modes de découpage utilisés par pthread_distrib_get_chunk
+enum
+{
+  PTHREAD_DISTRIB_CHUNK, // paquets de taille fixe
+  PTHREAD_DISTRIB_GUIDED // paquets décroissants, jamais plus petits que chunk
+};
 
 typedef struct
 {
   pthread_mutex_t mutex;
   pthread_cond_t cond;
   unsigned int limit;
-  unsigned int count;
-  unsigned int phase;
+  atomic_uint count;
+  atomic_uint phase;
+  atomic_uint sleeping;
   unsigned int total_elements;
-  unsigned int next_element;
+  atomic_uint next_element;
+  int mode;
+  unsigned int chunk;
   void (*finalize_func) (void);
 } pthread_distrib_t;
 
 int pthread_distrib_init (pthread_distrib_t *distrib, unsigned nb_threads,
 			  unsigned nb_elements, void (*f)(void));
 
+// À appeler après pthread_distrib_init, avant toute distribution
+void pthread_distrib_set_chunk (pthread_distrib_t *distrib, int mode,
+                                unsigned chunk);
+
 int pthread_distrib_get (pthread_distrib_t *distrib);
 
+// Range dans *first le premier élément d'un paquet et renvoie sa taille.
+// Renvoie 0 une fois que tous les threads ont épuisé la phase courante.
+unsigned pthread_distrib_get_chunk (pthread_distrib_t *distrib,
+                                    unsigned *first);
+
 #endif
@@ -0,0 +1,21 @@
+
+#ifndef ROOFLINE_IS_DEF
+#define ROOFLINE_IS_DEF
+
+// Modèle roofline (option --roofline)
+//
+// À la fin d'une exécution sans affichage, on mesure le débit mémoire
+// soutenable (triad à la STREAM) et le débit crête en opérations entières et
+// flottantes, avec les mêmes threads OpenMP que la variante. Le noyau peut
+// décrire le coût d'une cellule en fournissant
+//
+//   void <noyau>_roofline (double *bytes, double *int_ops, double *flops);
+//
+// ce qui permet de situer la variante par rapport au plafond atteignable.
+
+extern unsigned do_roofline;
+
+void roofline_init (void);
+void roofline_report (unsigned long usecs, unsigned iterations);
+
+#endif
@@ -1,3 +1,4 @@
+
 #ifndef SCHEDULER_IS_DEF
 #define SCHEDULER_IS_DEF
 
@@ -9,6 +10,49 @@ void scheduler_finalize (void);
 
 void scheduler_task_wait (void);
 void scheduler_create_task (task_func_t task, void *param, unsigned cpu);
+// Soumet n tâches à la fois, réparties comme scheduler_place
+void scheduler_create_tasks (task_func_t task, void *params[], unsigned n);
+
+// Worker attitré de la tuile (i, j) d'une grille ni x nj
+unsigned scheduler_place (unsigned i, unsigned j, unsigned ni, unsigned nj);
+
+// Tâches avec dépendances
+//
+// scheduler_submit renvoie un descripteur de tâche, utilisable comme
+// dépendance d'une tâche soumise plus tard : la tâche n'est exécutée
+// qu'une fois toutes ses dépendances terminées (les dépendances NULL sont
+// ignorées). Les descripteurs restent valides jusqu'à ce que leur groupe
+// soit attendu (scheduler_task_wait pour le groupe par défaut, NULL).
+//
+//   task_t t = scheduler_submit (f, p, -1, g, after (left, up));
+
+typedef struct sched_task *task_t;
+typedef struct task_group *task_group_t;
+
+#define after(...)                                                             \
+  (task_t[]){__VA_ARGS__}, (sizeof ((task_t[]){__VA_ARGS__}) / sizeof (task_t))
+
+task_t scheduler_submit (task_func_t task, void *param, unsigned cpu,
+                         task_group_t group, task_t *deps, unsigned nb_deps);
+
+task_group_t scheduler_group_create (void);
+void scheduler_group_wait (task_group_t group);
+void scheduler_group_destroy (task_group_t group);
+
+// Boucle parallèle sur un rectangle de l'image : l'intervalle n'est coupé
+// en deux que lorsque des workers sont inoccupés, jusqu'à des blocs de
+// min_size (en lignes et en colonnes ; les coupes restent multiples de
+// min_size). body est appelée sur des sous-rectangles disjoints.
+
+typedef struct
+{
+  int x, y, w, h;
+} range_2d_t;
+
+typedef void (*range_body_t) (range_2d_t r, void *arg, unsigned who);
+
+void scheduler_parallel_for_2d (range_2d_t range, unsigned min_size,
+                                range_body_t body, void *arg);
 
 
 #endif
@@ -0,0 +1,47 @@
+
+#ifndef TRACE_IS_DEF
+#define TRACE_IS_DEF
+
+#include <stdint.h>
+
+// Enregistrement des tuiles calculées par chaque thread (option --trace)
+//
+// Chaque thread dispose de son propre tampon, formé de blocs chaînés : un
+// enregistrement ne prend ni verrou ni instruction atomique. Les tampons
+// sont exportés à la fin de l'exécution aux formats Chrome (trace_event
+// JSON, lisible par chrome://tracing ou Perfetto) et Paje (ViTE).
+//
+// Les mêmes tampons alimentent la fenêtre de monitoring (-m), qui les relit
+// entre deux calculs au lieu de dessiner depuis les threads de calcul.
+
+typedef struct
+{
+  uint64_t start, end; // ns depuis trace_init
+  int x, y, w, h;
+  int who; // numéro logique du thread (couleur du monitoring)
+  int cpu;
+  unsigned iteration;
+} trace_event_t;
+
+typedef void (*trace_replay_func_t) (trace_event_t *e);
+
+extern unsigned do_trace, trace_enabled;
+extern char *trace_prefix;
+extern unsigned trace_iteration;
+extern __thread uint64_t trace_tile_start;
+
+void trace_init (void);
+void trace_finalize (void);
+uint64_t trace_now (void);
+void trace_record (int x, int y, int w, int h, int who);
+
+// Relit les événements enregistrés depuis le dernier appel ; ne doit pas
+// être appelée pendant un calcul
+void trace_replay (trace_replay_func_t f);
+
+static inline void trace_next_iteration (void)
+{
+  trace_iteration++;
+}
+
+#endif
@@ -0,0 +1,28 @@
+
+#ifndef VALIDATE_IS_DEF
+#define VALIDATE_IS_DEF
+
+// Validation d'une variante (option --validate k)
+//
+// La variante choisie est exécutée en parallèle de la version de référence
+// <noyau>_compute_seq, chacune sur ses propres images. Toutes les k
+// générations, les deux images sont découpées en tuiles dont on compare les
+// empreintes ; la première génération et la première tuile qui diffèrent
+// sont signalées.
+//
+// Avec --golden <fichier>, les empreintes sont comparées à celles
+// enregistrées dans le fichier (qui est créé s'il n'existe pas encore), sans
+// exécuter la version de référence.
+//
+// Un noyau qui conserve un état en dehors des images (comme le cadrage de
+// mandel) peut fournir <noyau>_validate_state (int save) pour que cet état
+// soit sauvegardé avant la version de référence puis restauré avant la
+// variante.
+
+extern unsigned validate_period;
+extern char *validate_golden;
+
+// Renvoie 0 si la variante est conforme, 1 sinon
+int validate_run (int *iterations);
+
+#endif
@@ -45,24 +45,44 @@ __kernel void mandel (__global unsigned *img,
   float xc = leftX + xstep * j;
   float yc = topY - ystep * i;
   float x = 0.0, y = 0.0;	/* Z = X+I*Y */
+  float sx = 0.0, sy = 0.0;	/* Z mémorisé pour la détection de cycle */
 
   unsigned iter;
 
-  // Pour chaque pixel, on calcule les termes d'une suite, et on
-  // s'arrête lorsque |Z| > 2 ou lorsqu'on atteint MAX_ITERATIONS
-  for (iter = 0; iter < MAX_ITERATIONS; iter++) {
-    float x2 = x*x;
-    float y2 = y*y;
+  // Cardioïde principale et bourgeon de période 2 : le point ne s'échappe
+  // jamais
+  float yc2 = yc * yc;
+  float q = (xc - 0.25f) * (xc - 0.25f) + yc2;
 
-    /* Stop iterations when |Z| > 2 */
-    if (x2 + y2 > 4.0)
-      break;
-	
-    float twoxy = (float)2.0 * x * y;
-    /* Z = Z^2 + C */
-    x = x2 - y2 + xc;
-    y = twoxy + yc;
-  }
+  if (q * (q + xc - 0.25f) <= 0.25f * yc2 ||
+      (xc + 1.0f) * (xc + 1.0f) + yc2 <= 0.0625f)
+    iter = MAX_ITERATIONS;
+  else
+    // Pour chaque pixel, on calcule les termes d'une suite, et on
+    // s'arrête lorsque |Z| > 2 ou lorsqu'on atteint MAX_ITERATIONS
+    for (iter = 0; iter < MAX_ITERATIONS; iter++) {
+      float x2 = x*x;
+      float y2 = y*y;
+
+      /* Stop iterations when |Z| > 2 */
+      if (x2 + y2 > 4.0)
+	break;
+
+      float twoxy = (float)2.0 * x * y;
+      /* Z = Z^2 + C */
+      x = x2 - y2 + xc;
+      y = twoxy + yc;
+
+      // Cycle (Brent) : Z mémorisé aux itérations 2^k
+      if (x == sx && y == sy) {
+	iter = MAX_ITERATIONS;
+	break;
+      }
+      if (((iter + 1) & iter) == 0) {
+	sx = x;
+	sy = y;
+      }
+    }
 
   img [i * DIM + j] = (iter < MAX_ITERATIONS)
     ? mandel_iter2color (iter)
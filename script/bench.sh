@@ -0,0 +1,240 @@
+#!/usr/bin/env bash
+#
+# Campagne de mesures : variantes x tailles x grains x threads x motifs
+#
+# Usage: script/bench.sh [options]   (ou make bench BENCH_ARGS="...")
+#
+#   -k "<noyaux>"     noyaux à mesurer            (défaut : tous sauf none)
+#   -v "<variantes>"  variantes à mesurer         (défaut : toutes, hors ocl/mpi)
+#   -s "<tailles>"    valeurs de DIM              (défaut : "512 1024")
+#   -g "<grains>"     valeurs de GRAIN            (défaut : "16 32")
+#   -t "<threads>"    nombres de threads          (défaut : 1 2 4 ... nproc)
+#   -a "<motifs>"     motifs (-a) pour vie        (défaut : "guns random")
+#   -i <n>            itérations par exécution    (défaut : 100)
+#   -m strong|weak    passage à l'échelle fort (DIM fixe) ou faible (DIM
+#                     croît avec la racine du nombre de threads)
+#   -f csv|json       format de sortie            (défaut : csv)
+#   -o <fichier>      fichier de sortie           (défaut : sortie standard)
+#   -w <n>            exécutions de chauffe       (défaut : 1)
+#   -r <min>:<max>    nombre min/max de mesures   (défaut : 3:10)
+#   -c <pct>          demi-largeur visée de l'intervalle de confiance à 95 %,
+#                     en % de la moyenne          (défaut : 5)
+#
+# Les mesures sont répétées jusqu'à ce que l'intervalle de confiance soit
+# assez étroit (ou que le maximum soit atteint). L'accélération est calculée
+# par rapport à la variante seq du même noyau, avec 1 thread.
+
+PROG=${PROG:-./2Dcomp}
+KERNELS=""
+VARIANTS=""
+DIMS="512 1024"
+GRAINS="16 32"
+THREADS=""
+PATTERNS="guns random"
+ITER=100
+MODE=strong
+FORMAT=csv
+OUTPUT=""
+WARMUP=1
+MIN_RUNS=3
+MAX_RUNS=10
+CI_PCT=5
+
+while getopts "k:v:s:g:t:a:i:m:f:o:w:r:c:h" opt; do
+    case $opt in
+        k) KERNELS=$OPTARG ;;
+        v) VARIANTS=$OPTARG ;;
+        s) DIMS=$OPTARG ;;
+        g) GRAINS=$OPTARG ;;
+        t) THREADS=$OPTARG ;;
+        a) PATTERNS=$OPTARG ;;
+        i) ITER=$OPTARG ;;
+        m) MODE=$OPTARG ;;
+        f) FORMAT=$OPTARG ;;
+        o) OUTPUT=$OPTARG ;;
+        w) WARMUP=$OPTARG ;;
+        r) MIN_RUNS=${OPTARG%:*}; MAX_RUNS=${OPTARG#*:} ;;
+        c) CI_PCT=$OPTARG ;;
+        *) sed -n '3,27p' "$0" | sed 's/^# \{0,1\}//'; exit 1 ;;
+    esac
+done
+
+die () { echo "bench: $*" >&2; exit 1; }
+
+[ -x "$PROG" ] || die "$PROG not found (run make first)"
+[ "$MODE" = strong ] || [ "$MODE" = weak ] || die "unknown mode $MODE"
+[ "$FORMAT" = csv ] || [ "$FORMAT" = json ] || die "unknown format $FORMAT"
+[ "$MIN_RUNS" -ge 2 ] 2>/dev/null || die "at least 2 runs are needed"
+
+NCPU=$(nproc 2>/dev/null || getconf _NPROCESSORS_ONLN)
+
+if [ -z "$THREADS" ]; then
+    t=1
+    while [ $t -lt "$NCPU" ]; do THREADS="$THREADS $t"; t=$((t * 2)); done
+    THREADS="$THREADS $NCPU"
+fi
+
+# Threads fixés aux cœurs, sauf si l'utilisateur en a décidé autrement
+export OMP_PLACES=${OMP_PLACES:-cores}
+export OMP_PROC_BIND=${OMP_PROC_BIND:-close}
+
+# Les variantes sont les fonctions <noyau>_compute_<variante> du binaire
+SYMBOLS=$(nm -g --defined-only "$PROG" | awk '$2 == "T" && $3 ~ /_compute_/ { print $3 }')
+
+[ -n "$KERNELS" ] || KERNELS=$(echo "$SYMBOLS" | sed 's/_compute_.*//' | sort -u | grep -v '^none$')
+
+variants_of () {
+    if [ -n "$VARIANTS" ]; then
+        echo $VARIANTS
+    else
+        echo "$SYMBOLS" | sed -n "s/^$1_compute_//p" | grep -v -e '^ocl' -e '^mpi' | sort
+    fi
+}
+
+# Variantes séquentielles : inutile de faire varier le nombre de threads
+is_sequential () {
+    case $1 in seq* | vec | tiled | refill | ms | f64 | pert) return 0 ;; *) return 1 ;; esac
+}
+
+# Variantes non tuilées : GRAIN n'a pas d'effet
+ignores_grain () {
+    case $1 in seq | seq_base | vec | refill | prog | f64 | pert | *base*) return 0 ;; *) return 1 ;; esac
+}
+
+# DIM pour t threads : en passage à l'échelle faible, le nombre de cellules
+# par thread reste constant (arrondi à un multiple de 64)
+dim_for () {
+    if [ "$MODE" = weak ]; then
+        awk -v d="$1" -v t="$2" 'BEGIN { printf "%d\n", int(d * sqrt(t) / 64) * 64 }'
+    else
+        echo "$1"
+    fi
+}
+
+# Une exécution ; affiche la durée en ms (dernière ligne de stderr)
+run_once () {
+    local threads=$1; shift
+    OMP_NUM_THREADS=$threads "$PROG" -n "$@" 2>&1 >/dev/null | tail -n 1
+}
+
+# Mesures répétées ; affiche "runs moyenne écart-type demi-largeur_IC"
+measure () {
+    local threads=$1; shift
+    local times="" n=0 stats
+
+    for ((w = 0; w < WARMUP; w++)); do run_once "$threads" "$@" >/dev/null; done
+
+    while :; do
+        t=$(run_once "$threads" "$@")
+        [[ $t =~ ^[0-9]+\.[0-9]+$ ]] || { echo "bench: failed: $PROG -n $*" >&2; return 1; }
+        times="$times $t"
+        n=$((n + 1))
+        [ $n -ge "$MIN_RUNS" ] || continue
+        stats=$(echo $times | awk -v pct="$CI_PCT" '
+            BEGIN { split("12.706 4.303 3.182 2.776 2.571 2.447 2.365 2.306 2.262 2.228 " \
+                          "2.201 2.179 2.160 2.145 2.131 2.120 2.110 2.101 2.093 2.086", tq) }
+            {
+                for (i = 1; i <= NF; i++) { s += $i; s2 += $i * $i }
+                m = s / NF; v = (s2 - NF * m * m) / (NF - 1); if (v < 0) v = 0
+                q = (NF - 1 <= 20) ? tq[NF - 1] : 1.96
+                ci = q * sqrt(v / NF)
+                printf "%d %.3f %.3f %.3f %d\n", NF, m, sqrt(v), ci, (ci <= m * pct / 100)
+            }')
+        if [ "${stats##* }" = 1 ] || [ $n -ge "$MAX_RUNS" ]; then
+            echo "${stats% *}"
+            return 0
+        fi
+    done
+}
+
+host_info () {
+    local model sockets cores numa
+    model=$(awk -F': ' '/^model name/ { print $2; exit }' /proc/cpuinfo 2>/dev/null)
+    sockets=$(grep '^physical id' /proc/cpuinfo 2>/dev/null | sort -u | wc -l)
+    cores=$(awk -F': ' '/^physical id/ { p = $2 } /^core id/ { print p "-" $2 }' /proc/cpuinfo 2>/dev/null | sort -u | wc -l)
+    numa=$(ls -d /sys/devices/system/node/node* 2>/dev/null | wc -l)
+    echo "$(hostname)|${model:-unknown}|${sockets:-0}|${cores:-0}|$NCPU|${numa:-0}|$(uname -r)|$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+}
+
+declare -A SEQ_TIME SEQ_STATS
+
+# Temps de référence (variante seq, 1 thread), mémorisé dans REF, et mesures
+# complètes dans REF_STATS ; la fonction ne doit pas être appelée dans un
+# sous-shell pour que le cache serve
+reference () {
+    local kernel=$1 dim=$2 pattern=$3 key="$1/$2/$3" args
+    if [ -z "${SEQ_TIME[$key]}" ]; then
+        args=(-k "$kernel" -v seq -s "$dim" -i "$ITER")
+        [ -n "$pattern" ] && args+=(-a "$pattern")
+        SEQ_STATS[$key]=""
+        if echo "$SYMBOLS" | grep -qx "${kernel}_compute_seq"; then
+            SEQ_STATS[$key]=$(measure 1 "${args[@]}")
+            set -- ${SEQ_STATS[$key]}
+            SEQ_TIME[$key]=${2:-0}
+        else
+            SEQ_TIME[$key]=0
+        fi
+    fi
+    REF=${SEQ_TIME[$key]}
+    REF_STATS=${SEQ_STATS[$key]}
+}
+
+IFS='|' read -r H_NAME H_MODEL H_SOCKETS H_CORES H_PUS H_NUMA H_OS H_DATE <<< "$(host_info)"
+
+[ -n "$OUTPUT" ] && exec > "$OUTPUT"
+
+if [ "$FORMAT" = csv ]; then
+    echo "# host=$H_NAME cpu=\"$H_MODEL\" sockets=$H_SOCKETS cores=$H_CORES pus=$H_PUS numa=$H_NUMA os=$H_OS date=$H_DATE mode=$MODE"
+    echo "kernel,variant,pattern,dim,grain,threads,iterations,runs,mean_ms,stddev_ms,ci95_ms,cells_per_s,speedup"
+else
+    printf '{\n  "host": {"name": "%s", "cpu": "%s", "sockets": %d, "cores": %d, "pus": %d, "numa_nodes": %d, "os": "%s", "date": "%s"},\n' \
+           "$H_NAME" "$H_MODEL" "$H_SOCKETS" "$H_CORES" "$H_PUS" "$H_NUMA" "$H_OS" "$H_DATE"
+    printf '  "mode": "%s",\n  "results": [' "$MODE"
+fi
+
+first=1
+for kernel in $KERNELS; do
+    pats=$PATTERNS
+    [ "$kernel" = vie ] || pats="-"
+    for variant in $(variants_of "$kernel"); do
+        grains=$GRAINS
+        ignores_grain "$variant" && grains=${GRAINS%% *}
+        threads_list=$THREADS
+        is_sequential "$variant" && threads_list=1
+        for base_dim in $DIMS; do
+            for pattern in $pats; do
+                [ "$pattern" = - ] && pattern=""
+                for grain in $grains; do
+                    for threads in $threads_list; do
+                        dim=$(dim_for "$base_dim" "$threads")
+                        args=(-k "$kernel" -v "$variant" -s "$dim" -g "$grain" -i "$ITER")
+                        [ -n "$pattern" ] && args+=(-a "$pattern")
+                        echo "bench: $kernel $variant ${pattern:+$pattern }DIM=$dim GRAIN=$grain threads=$threads" >&2
+                        reference "$kernel" "$dim" "$pattern"
+                        # seq sur 1 thread est la référence : déjà mesurée
+                        if [ "$variant" = seq ] && [ "$threads" = 1 ] && [ -n "$REF_STATS" ]; then
+                            res=$REF_STATS
+                        else
+                            res=$(measure "$threads" "${args[@]}") || continue
+                        fi
+                        set -- $res
+                        line=$(awk -v d="$dim" -v it="$ITER" -v m="$2" -v ref="$REF" 'BEGIN {
+                            printf "%.0f %.3f\n", (m > 0 ? d * d * it / (m / 1000) : 0), (m > 0 ? ref / m : 0) }')
+                        cells=${line% *}; speedup=${line#* }
+                        if [ "$FORMAT" = csv ]; then
+                            echo "$kernel,$variant,$pattern,$dim,$grain,$threads,$ITER,$1,$2,$3,$4,$cells,$speedup"
+                        else
+                            [ $first = 1 ] || printf ','
+                            printf '\n    {"kernel": "%s", "variant": "%s", "pattern": "%s", "dim": %d, "grain": %d, "threads": %d, "iterations": %d, "runs": %d, "mean_ms": %s, "stddev_ms": %s, "ci95_ms": %s, "cells_per_s": %s, "speedup": %s}' \
+                                   "$kernel" "$variant" "$pattern" "$dim" "$grain" "$threads" "$ITER" "$1" "$2" "$3" "$4" "$cells" "$speedup"
+                        fi
+                        first=0
+                    done
+                done
+            done
+        done
+    done
+done
+
+[ "$FORMAT" = json ] && printf '\n  ]\n}\n'
+exit 0
@@ -21,7 +21,7 @@ for i in 512 4096 ;  # 2 tailles : -s 256 puis -s 512
 do
     execute $i -v seq_base
     execute $i -v omp_base_static
-    execute $i -v omp_base_cylic
+    execute $i -v omp_base_cyclic
     execute $i -v omp_base_dynamic
     execute $i -v omp_base_collapse
 done
@@ -0,0 +1,822 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <hwloc.h>
+#include <math.h>
+#include <omp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <elf.h>
+#endif
+
+#include "autotune.h"
+#include "compute.h"
+#include "constants.h"
+#include "debug.h"
+#include "error.h"
+#include "global.h"
+
+unsigned do_autotune = 0;
+
+#define MAX_VARIANTS 64
+#define MAX_GRAINS 16
+#define TRIAL_REPEAT 2
+#define TRIAL_ITERATIONS 20
+#define KEEP_VARIANTS 3
+
+// Seuils d'élagage : une variante à plus de 10 % de la meilleure est
+// abandonnée, de même qu'une direction de GRAIN qui se dégrade deux fois ;
+// on ne change l'ordonnancement que pour gagner plus de 5 % et on préfère
+// moins de threads tant qu'on reste à 3 % du meilleur temps
+#define VARIANT_SLACK 1.10
+#define GRAIN_SLACK 1.10
+#define SCHEDULE_GAIN 1.05
+#define THREADS_SLACK 1.03
+
+typedef struct
+{
+  char variant[64];
+  unsigned grain;
+  unsigned threads;
+  char schedule[32]; // "" : valeur par défaut du support d'exécution
+  unsigned tilex, tiley;
+  double time; // ms
+} config_t;
+
+static const char *schedules[] = {"static,1", "dynamic,1", "dynamic,4",
+                                  "guided", "static"};
+
+// Variantes non tuilées, pour lesquelles GRAIN n'a pas d'effet (même liste
+// que script/bench.sh)
+static const char *no_grain[] = {"seq",  "seq_base", "vec",  "refill",
+                                 "prog", "f64",      "pert", "*base*"};
+
+// Empreintes de référence (--golden), enregistrées une fois par variante de
+// référence puis comparées à chaque variante qui doit lui être identique
+#define MAX_REFERENCES 8
+
+typedef struct
+{
+  char variant[64];
+  char file[1024];
+  int valid; // 0 : la référence n'a pas pu être exécutée
+} reference_t;
+
+typedef const char *(*reference_func_t) (const char *variant);
+
+static reference_t references[MAX_REFERENCES];
+static int nb_references                 = 0;
+static reference_func_t kernel_reference = NULL;
+
+static char *exe      = NULL;
+static unsigned dim   = 0;
+static unsigned iters = 0;
+static double best_ms = 0.0; // borne pour le délai de garde des essais
+
+static char *profile_name (void)
+{
+  static char name[1024];
+  char *str = getenv ("AUTOTUNE_PROFILE");
+
+  if (str != NULL)
+    return str;
+
+  str = getenv ("HOME");
+  snprintf (name, sizeof (name), "%s/.2Dcomp-autotune",
+            str != NULL ? str : ".");
+  return name;
+}
+
+static void no_spaces (char *s)
+{
+  for (; *s; s++)
+    if (*s == ' ' || *s == '\t')
+      *s = '_';
+}
+
+// Clé décrivant la machine : boîtiers, cœurs, unités de calcul et modèle
+static void topology_key (char *key, size_t size)
+{
+  hwloc_topology_t topo;
+  hwloc_obj_t obj;
+  const char *model = NULL;
+
+  hwloc_topology_init (&topo);
+  hwloc_topology_load (topo);
+
+  obj = hwloc_get_obj_by_type (topo, HWLOC_OBJ_PACKAGE, 0);
+  if (obj != NULL)
+    model = hwloc_obj_get_info_by_name (obj, "CPUModel");
+  if (model == NULL)
+    model = hwloc_obj_get_info_by_name (hwloc_get_root_obj (topo), "CPUModel");
+
+  snprintf (key, size, "%dp%dc%dt-%s",
+            hwloc_get_nbobjs_by_type (topo, HWLOC_OBJ_PACKAGE),
+            hwloc_get_nbobjs_by_type (topo, HWLOC_OBJ_CORE),
+            hwloc_get_nbobjs_by_type (topo, HWLOC_OBJ_PU),
+            model != NULL ? model : "unknown");
+  no_spaces (key);
+
+  hwloc_topology_destroy (topo);
+}
+
+static void draw_key (char *arg, size_t size)
+{
+  snprintf (arg, size, "%s", draw_param != NULL ? draw_param : "-");
+  no_spaces (arg);
+}
+
+///////////////////////////// Essais
+
+// check != 0 : exécution avec --validate check --golden golden au lieu d'une
+// mesure
+static void child_exec (config_t *c, unsigned check, const char *golden,
+                        int err_fd)
+{
+  char s_dim[16], s_grain[16], s_iter[16], s_val[16], s_check[16];
+  char *argv[32];
+  int argc = 0, null_fd;
+
+  null_fd = open ("/dev/null", O_WRONLY);
+  dup2 (null_fd, STDOUT_FILENO);
+  dup2 (err_fd, STDERR_FILENO);
+
+  setenv ("KERNEL", kernel, 1);
+  if (c->threads) {
+    snprintf (s_val, sizeof (s_val), "%u", c->threads);
+    setenv ("OMP_NUM_THREADS", s_val, 1);
+  }
+  if (c->schedule[0])
+    setenv ("OMP_SCHEDULE", c->schedule, 1);
+  if (c->tilex) {
+    snprintf (s_val, sizeof (s_val), "%u", c->tilex);
+    setenv ("TILEX", s_val, 1);
+    snprintf (s_val, sizeof (s_val), "%u", c->tiley);
+    setenv ("TILEY", s_val, 1);
+  }
+
+  snprintf (s_dim, sizeof (s_dim), "%u", dim);
+  snprintf (s_grain, sizeof (s_grain), "%u", c->grain);
+  snprintf (s_iter, sizeof (s_iter), "%u", iters);
+
+  argv[argc++] = "2Dcomp";
+  argv[argc++] = "-n";
+  argv[argc++] = "-k";
+  argv[argc++] = kernel;
+  argv[argc++] = "-v";
+  argv[argc++] = c->variant;
+  argv[argc++] = "-s";
+  argv[argc++] = s_dim;
+  argv[argc++] = "-g";
+  argv[argc++] = s_grain;
+  argv[argc++] = "-i";
+  argv[argc++] = s_iter;
+  if (check) {
+    snprintf (s_check, sizeof (s_check), "%u", check);
+    argv[argc++] = "-val";
+    argv[argc++] = s_check;
+    argv[argc++] = "-gd";
+    argv[argc++] = (char *)golden;
+  }
+  if (draw_param != NULL) {
+    argv[argc++] = "-a";
+    argv[argc++] = draw_param;
+  }
+  if (do_first_touch)
+    argv[argc++] = "-ft";
+  if (opencl_used)
+    argv[argc++] = "-o";
+  argv[argc] = NULL;
+
+  execv (exe, argv);
+  _exit (127);
+}
+
+static double elapsed_ms (struct timeval *t0)
+{
+  struct timeval t;
+
+  gettimeofday (&t, NULL);
+  return (t.tv_sec - t0->tv_sec) * 1e3 + (t.tv_usec - t0->tv_usec) / 1e3;
+}
+
+// Une exécution sans affichage ; la fin de sa sortie d'erreur est rangée
+// dans buf. Renvoie 0 si l'exécution a échoué ou a dû être interrompue.
+static int run_child (config_t *c, unsigned check, const char *golden,
+                      char *buf, size_t size)
+{
+  size_t len = 0;
+  int fd[2], status;
+  double limit = best_ms > 0 && !check ? 4 * best_ms + 2000.0 : 120000.0;
+  struct timeval t0;
+  pid_t pid;
+
+  if (pipe (fd) < 0)
+    exit_with_error ("Cannot create pipe for autotune trial\n");
+
+  pid = fork ();
+  if (pid < 0)
+    exit_with_error ("Cannot fork autotune trial\n");
+  if (pid == 0) {
+    close (fd[0]);
+    child_exec (c, check, golden, fd[1]);
+  }
+  close (fd[1]);
+
+  gettimeofday (&t0, NULL);
+  for (;;) {
+    struct pollfd p = {fd[0], POLLIN, 0};
+    double left     = limit - elapsed_ms (&t0);
+    ssize_t n;
+
+    if (left <= 0 || poll (&p, 1, (int)left) == 0) {
+      kill (pid, SIGKILL);
+      waitpid (pid, NULL, 0);
+      close (fd[0]);
+      PRINT_DEBUG ('c', "Trial %s killed after %.0f ms\n", c->variant, limit);
+      return 0;
+    }
+
+    // On ne garde que la fin de la sortie
+    if (len == size - 1) {
+      memmove (buf, buf + len / 2, len - len / 2);
+      len -= len / 2;
+    }
+    n = read (fd[0], buf + len, size - 1 - len);
+    if (n <= 0)
+      break;
+    len += n;
+  }
+  close (fd[0]);
+  buf[len] = '\0';
+
+  waitpid (pid, &status, 0);
+  return WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+// Le temps (en ms) est la dernière ligne écrite sur la sortie d'erreur.
+// Renvoie INFINITY en cas d'échec.
+static double run_once (config_t *c)
+{
+  char buf[4096], *line;
+  size_t len;
+
+  if (!run_child (c, 0, NULL, buf, sizeof (buf)))
+    return INFINITY;
+
+  len = strlen (buf);
+  while (len > 0 && buf[len - 1] == '\n')
+    buf[--len] = '\0';
+  line = strrchr (buf, '\n');
+  line = line != NULL ? line + 1 : buf;
+
+  return strtod (line, NULL) > 0 ? strtod (line, NULL) : INFINITY;
+}
+
+static double trial (config_t *c)
+{
+  double t = INFINITY;
+
+  for (int r = 0; r < TRIAL_REPEAT; r++) {
+    double d = run_once (c);
+
+    if (d < t)
+      t = d;
+    if (isinf (d))
+      break;
+  }
+
+  c->time = t;
+  if (!isinf (t) && (best_ms == 0.0 || t < best_ms))
+    best_ms = t;
+
+  printf ("  %-24s grain %4u  threads %3u  schedule %-10s", c->variant,
+          c->grain, c->threads, c->schedule[0] ? c->schedule : "default");
+  if (c->tilex)
+    printf ("  tile %2ux%-2u", c->tilex, c->tiley);
+  if (isinf (t))
+    printf (" :     failed\n");
+  else
+    printf (" : %10.3f ms\n", t);
+  fflush (stdout);
+
+  return t;
+}
+
+static unsigned check_period (void)
+{
+  return iters / 4 ? iters / 4 : 1;
+}
+
+// Le noyau peut indiquer, par <noyau>_reference (variante), la variante qui
+// calcule exactement comme celle-ci (les variantes vectorielles de mandel
+// n'arrondissent pas comme seq). Par défaut, c'est seq.
+static const char *reference_of (const char *variant)
+{
+  return kernel_reference != NULL ? kernel_reference (variant) : "seq";
+}
+
+// Enregistre au premier appel les empreintes de la variante de référence
+static reference_t *reference_get (config_t *c, const char *name)
+{
+  char buf[4096], *tmp = getenv ("TMPDIR");
+  reference_t *r;
+  config_t ref = *c;
+
+  for (int i = 0; i < nb_references; i++)
+    if (!strcmp (references[i].variant, name))
+      return &references[i];
+
+  if (nb_references == MAX_REFERENCES)
+    return NULL;
+
+  r = &references[nb_references++];
+  snprintf (r->variant, sizeof (r->variant), "%s", name);
+  snprintf (r->file, sizeof (r->file), "%s/2Dcomp-autotune-%d-%s",
+            tmp != NULL ? tmp : "/tmp", (int)getpid (), name);
+  unlink (r->file);
+
+  snprintf (ref.variant, sizeof (ref.variant), "%s", name);
+  r->valid = run_child (&ref, check_period (), r->file, buf, sizeof (buf));
+  if (!r->valid)
+    printf ("  (no usable reference %s_compute_%s: variants that should "
+            "match it are not validated)\n",
+            kernel, name);
+
+  return r;
+}
+
+static void references_clean (void)
+{
+  for (int i = 0; i < nb_references; i++)
+    unlink (references[i].file);
+  nb_references = 0;
+}
+
+// Une variante plus rapide mais fausse ne doit pas être retenue : ses
+// empreintes sont comparées à celles de sa variante de référence avant
+// d'être mesurée
+static int correct (config_t *c)
+{
+  char buf[4096];
+  const char *name = reference_of (c->variant);
+  reference_t *r;
+
+  if (name == NULL || !strcmp (name, c->variant))
+    return 1;
+
+  r = reference_get (c, name);
+  if (r == NULL || !r->valid ||
+      run_child (c, check_period (), r->file, buf, sizeof (buf)))
+    return 1;
+
+  printf ("  %-24s grain %4u  threads %3u  schedule %-10s :    invalid\n",
+          c->variant, c->grain, c->threads,
+          c->schedule[0] ? c->schedule : "default");
+  fflush (stdout);
+  return 0;
+}
+
+///////////////////////////// Variantes
+
+static int cmp_string (const void *a, const void *b)
+{
+  return strcmp (*(char *const *)a, *(char *const *)b);
+}
+
+static int add_variant (char **list, int nb, const char *name)
+{
+  if (nb == MAX_VARIANTS || strstr (name, "mpi") != NULL ||
+      (!opencl_used && strstr (name, "ocl") != NULL))
+    return nb;
+
+  for (int i = 0; i < nb; i++)
+    if (!strcmp (list[i], name))
+      return nb;
+
+  list[nb] = strdup (name);
+  return nb + 1;
+}
+
+// Les variantes sont les symboles <kernel>_compute_<variante> exportés par
+// l'exécutable (-rdynamic), lus dans sa table .dynsym
+static int list_variants (char **list)
+{
+  char *str = getenv ("AUTOTUNE_VARIANTS");
+  int nb    = 0;
+
+  if (str != NULL) {
+    char *copy = strdup (str), *save = NULL;
+
+    for (char *v = strtok_r (copy, ",", &save); v != NULL;
+         v = strtok_r (NULL, ",", &save))
+      nb = add_variant (list, nb, v);
+    free (copy);
+    return nb;
+  }
+
+#if defined(__linux__) && defined(__LP64__)
+  FILE *f = fopen (exe, "r");
+  char prefix[256];
+  size_t plen;
+
+  snprintf (prefix, sizeof (prefix), "%s_compute_", kernel);
+  plen = strlen (prefix);
+
+  if (f != NULL) {
+    Elf64_Ehdr eh;
+    Elf64_Shdr *sh = NULL;
+
+    if (fread (&eh, sizeof (eh), 1, f) == 1 &&
+        !memcmp (eh.e_ident, ELFMAG, SELFMAG) &&
+        eh.e_ident[EI_CLASS] == ELFCLASS64) {
+      sh = malloc (eh.e_shnum * sizeof (Elf64_Shdr));
+      fseek (f, eh.e_shoff, SEEK_SET);
+      if (fread (sh, sizeof (Elf64_Shdr), eh.e_shnum, f) != eh.e_shnum)
+        eh.e_shnum = 0;
+
+      for (int s = 0; s < eh.e_shnum; s++) {
+        Elf64_Shdr *strtab = &sh[sh[s].sh_link];
+        Elf64_Sym *sym;
+        char *names;
+        size_t nsym;
+
+        if (sh[s].sh_type != SHT_DYNSYM)
+          continue;
+
+        nsym  = sh[s].sh_size / sizeof (Elf64_Sym);
+        sym   = malloc (sh[s].sh_size);
+        names = malloc (strtab->sh_size + 1);
+        fseek (f, sh[s].sh_offset, SEEK_SET);
+        if (fread (sym, 1, sh[s].sh_size, f) != sh[s].sh_size)
+          nsym = 0;
+        fseek (f, strtab->sh_offset, SEEK_SET);
+        if (fread (names, 1, strtab->sh_size, f) != strtab->sh_size)
+          nsym = 0;
+        names[strtab->sh_size] = '\0';
+
+        for (size_t i = 0; i < nsym; i++) {
+          const char *n = names + sym[i].st_name;
+
+          if (sym[i].st_name < strtab->sh_size &&
+              ELF64_ST_TYPE (sym[i].st_info) == STT_FUNC &&
+              sym[i].st_shndx != SHN_UNDEF && !strncmp (n, prefix, plen) &&
+              n[plen] != '\0')
+            nb = add_variant (list, nb, n + plen);
+        }
+        free (sym);
+        free (names);
+      }
+      free (sh);
+    }
+    fclose (f);
+  }
+#endif
+
+  if (nb == 0)
+    nb = add_variant (list, nb, version);
+
+  qsort (list, nb, sizeof (char *), cmp_string);
+  return nb;
+}
+
+static int cmp_config (const void *a, const void *b)
+{
+  const config_t *x = a, *y = b;
+
+  return x->time < y->time ? -1 : x->time > y->time;
+}
+
+///////////////////////////// Recherche
+
+// Remontée de gradient sur les puissances de 2 qui divisent DIM, en
+// partant du grain courant, dans les deux sens
+static void tune_grain (config_t *best)
+{
+  unsigned grains[MAX_GRAINS];
+  int nb = 0, start = 0;
+
+  for (int i = 0; i < sizeof (no_grain) / sizeof (no_grain[0]); i++)
+    if (!fnmatch (no_grain[i], best->variant, 0))
+      return;
+
+  for (unsigned g = 1; g <= dim / 8 && nb < MAX_GRAINS; g *= 2)
+    if (dim % g == 0) {
+      if (g <= best->grain)
+        start = nb;
+      grains[nb++] = g;
+    }
+
+  for (int dir = -1; dir <= 1; dir += 2) {
+    int strikes = 0;
+
+    for (int i = dir < 0 ? start : start + 1; i >= 0 && i < nb && strikes < 2;
+         i += dir) {
+      config_t c = *best;
+
+      c.grain = grains[i];
+      if (c.grain == best->grain)
+        continue;
+      trial (&c);
+      if (c.time < best->time) {
+        *best   = c;
+        strikes = 0;
+      } else if (c.time > best->time * GRAIN_SLACK)
+        strikes++;
+    }
+  }
+}
+
+static void tune_schedule (config_t *best)
+{
+  config_t winner = *best;
+
+  for (int s = 0; s < sizeof (schedules) / sizeof (schedules[0]); s++) {
+    config_t c = *best;
+
+    strcpy (c.schedule, schedules[s]);
+    trial (&c);
+    if (c.time * SCHEDULE_GAIN < best->time && c.time < winner.time)
+      winner = c;
+  }
+  *best = winner;
+}
+
+static void tune_threads (config_t *best)
+{
+  config_t tried[32];
+  double fastest = best->time;
+  int nb         = 0;
+
+  tried[nb++] = *best;
+
+  for (unsigned t = best->threads / 2; t >= 1 && nb < 32; t /= 2) {
+    config_t c = *best;
+
+    c.threads = t;
+    trial (&c);
+    tried[nb++] = c;
+    if (c.time < fastest)
+      fastest = c.time;
+    else if (c.time > fastest * VARIANT_SLACK)
+      break; // moins de threads ne fera que ralentir
+  }
+
+  for (int i = 0; i < nb; i++)
+    if (tried[i].time <= fastest * THREADS_SLACK &&
+        tried[i].threads < best->threads)
+      *best = tried[i];
+}
+
+static void tune_ocl (config_t *best)
+{
+  static const unsigned sizes[] = {8, 16, 32};
+
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) {
+      config_t c = *best;
+
+      if (dim % sizes[i] || dim % sizes[j] ||
+          (sizes[i] == best->tilex && sizes[j] == best->tiley))
+        continue;
+      c.tilex = sizes[i];
+      c.tiley = sizes[j];
+      if (trial (&c) < best->time)
+        *best = c;
+    }
+}
+
+///////////////////////////// Profil
+
+static void profile_save (config_t *c)
+{
+  char key[1024], topo[256], arg[256], line[2048], tmp[1100];
+  char *name = profile_name ();
+  size_t klen;
+  FILE *in, *out;
+
+  topology_key (topo, sizeof (topo));
+  draw_key (arg, sizeof (arg));
+  snprintf (key, sizeof (key), "%s %s %u %s ", topo, kernel, dim, arg);
+  klen = strlen (key);
+
+  snprintf (tmp, sizeof (tmp), "%s.tmp", name);
+  out = fopen (tmp, "w");
+  if (out == NULL)
+    exit_with_error ("Cannot create %s\n", tmp);
+
+  in = fopen (name, "r");
+  if (in != NULL) {
+    while (fgets (line, sizeof (line), in) != NULL)
+      if (strncmp (line, key, klen))
+        fputs (line, out);
+    fclose (in);
+  }
+
+  fprintf (out, "%svariant=%s grain=%u threads=%u schedule=%s tilex=%u "
+                "tiley=%u time=%.3f\n",
+           key, c->variant, c->grain, c->threads,
+           c->schedule[0] ? c->schedule : "-", c->tilex, c->tiley, c->time);
+  fclose (out);
+
+  if (rename (tmp, name) < 0)
+    exit_with_error ("Cannot update %s\n", name);
+
+  printf ("Profile %s updated (machine %s)\n", name, topo);
+}
+
+int autotune_run (char *progname)
+{
+  char *variants[MAX_VARIANTS];
+  config_t cand[MAX_VARIANTS], best;
+  int nb, kept = 0;
+
+#ifdef __linux__
+  exe = "/proc/self/exe";
+#else
+  exe = progname;
+#endif
+
+  dim   = DIM ? DIM : DEFAULT_DIM;
+  iters = max_iter > 0 ? max_iter : TRIAL_ITERATIONS;
+
+  memset (&best, 0, sizeof (best));
+  best.grain   = GRAIN;
+  best.threads = get_nb_cores ();
+  best.time    = INFINITY;
+
+  if (opencl_used) {
+    // Seule la taille des groupes de travail compte
+    printf ("Autotuning kernel [%s] with OpenCL, DIM %u, %u iterations\n",
+            kernel, dim, iters);
+    strcpy (best.variant, "ocl");
+    best.threads = 0;
+    best.tilex = best.tiley = 16;
+    trial (&best);
+    tune_ocl (&best);
+  } else {
+    nb               = list_variants (variants);
+    kernel_reference = bind_it (kernel, "reference", version, 0);
+
+    printf ("Autotuning kernel [%s], DIM %u, %u iterations, %d variants\n",
+            kernel, dim, iters, nb);
+
+    printf ("Variants:\n");
+    for (int v = 0; v < nb; v++) {
+      cand[v] = best;
+      snprintf (cand[v].variant, sizeof (cand[v].variant), "%s", variants[v]);
+      if (!correct (&cand[v]))
+        cand[v].time = INFINITY;
+      else
+        trial (&cand[v]);
+      free (variants[v]);
+    }
+    references_clean ();
+    qsort (cand, nb, sizeof (config_t), cmp_config);
+
+    if (nb == 0 || isinf (cand[0].time))
+      exit_with_error ("No variant of kernel %s could run\n", kernel);
+
+    while (kept < nb && kept < KEEP_VARIANTS &&
+           cand[kept].time <= cand[0].time * VARIANT_SLACK)
+      kept++;
+
+    printf ("Grain:\n");
+    for (int v = 0; v < kept; v++) {
+      tune_grain (&cand[v]);
+      if (cand[v].time < best.time)
+        best = cand[v];
+    }
+
+    // OMP_SCHEDULE n'agit que sur les boucles OpenMP schedule(runtime)
+    if (!strncmp (best.variant, "omp", 3)) {
+      printf ("Schedule:\n");
+      tune_schedule (&best);
+    }
+
+    printf ("Threads:\n");
+    tune_threads (&best);
+  }
+
+  if (isinf (best.time))
+    exit_with_error ("Autotuning failed: no configuration could run\n");
+
+  printf ("Best: variant %s, grain %u, %u threads, schedule %s", best.variant,
+          best.grain, best.threads,
+          best.schedule[0] ? best.schedule : "default");
+  if (best.tilex)
+    printf (", tile %ux%u", best.tilex, best.tiley);
+  printf (" (%.3f ms)\n", best.time);
+
+  profile_save (&best);
+
+  return EXIT_SUCCESS;
+}
+
+///////////////////////////// Chargement (-v auto)
+
+static void apply_schedule (const char *s)
+{
+  omp_sched_t kind = omp_sched_static;
+  const char *comma = strchr (s, ',');
+  int chunk         = comma != NULL ? atoi (comma + 1) : 0;
+
+  if (!strncmp (s, "dynamic", 7))
+    kind = omp_sched_dynamic;
+  else if (!strncmp (s, "guided", 6))
+    kind = omp_sched_guided;
+  else if (!strncmp (s, "auto", 4))
+    kind = omp_sched_auto;
+
+  // OMP_SCHEDULE n'est lu qu'au démarrage du support d'exécution
+  setenv ("OMP_SCHEDULE", s, 1);
+  omp_set_schedule (kind, chunk);
+}
+
+void autotune_load (void)
+{
+  char topo[256], arg[256], line[1024];
+  char *name    = profile_name ();
+  unsigned want = DIM ? DIM : DEFAULT_DIM;
+  unsigned best_dim = 0;
+  config_t c, found;
+  int have = 0;
+  FILE *f;
+
+  topology_key (topo, sizeof (topo));
+  draw_key (arg, sizeof (arg));
+
+  f = fopen (name, "r");
+  if (f != NULL) {
+    while (fgets (line, sizeof (line), f) != NULL) {
+      char t[256], k[128], a[256], sched[32];
+      unsigned d;
+
+      memset (&c, 0, sizeof (c));
+      if (sscanf (line,
+                  "%255s %127s %u %255s variant=%63s grain=%u threads=%u "
+                  "schedule=%31s tilex=%u tiley=%u time=%lf",
+                  t, k, &d, a, c.variant, &c.grain, &c.threads, sched,
+                  &c.tilex, &c.tiley, &c.time) != 11)
+        continue;
+      if (strcmp (t, topo) || strcmp (k, kernel) || strcmp (a, arg))
+        continue;
+
+      // À défaut de DIM identique, on retient le réglage le plus proche
+      if (!have || abs ((int)d - (int)want) < abs ((int)best_dim - (int)want)) {
+        if (strcmp (sched, "-"))
+          strcpy (c.schedule, sched);
+        found    = c;
+        best_dim = d;
+        have     = 1;
+      }
+    }
+    fclose (f);
+  }
+
+  if (!have) {
+    fprintf (stderr,
+             "Warning: no autotune profile for kernel %s on this machine (%s) "
+             "in %s, using variant %s\n",
+             kernel, topo, name, DEFAULT_VARIANT);
+    version = DEFAULT_VARIANT;
+    return;
+  }
+
+  version = strdup (found.variant);
+  if (!strcmp (version, "ocl"))
+    opencl_used = 1;
+  if (found.grain)
+    GRAIN = found.grain;
+
+  if (found.threads) {
+    char s[16];
+
+    snprintf (s, sizeof (s), "%u", found.threads);
+    setenv ("OMP_NUM_THREADS", s, 1);
+    omp_set_num_threads (found.threads);
+  }
+  if (found.schedule[0])
+    apply_schedule (found.schedule);
+  if (found.tilex) {
+    char s[16];
+
+    snprintf (s, sizeof (s), "%u", found.tilex);
+    setenv ("TILEX", s, 1);
+    snprintf (s, sizeof (s), "%u", found.tiley);
+    setenv ("TILEY", s, 1);
+  }
+
+  printf ("Autotune profile: variant %s, grain %u, %u threads, schedule %s "
+          "(tuned for DIM %u)\n",
+          version, GRAIN, found.threads,
+          found.schedule[0] ? found.schedule : "default", best_dim);
+}
@@ -0,0 +1,212 @@
+
+#include "barrier.h"
+#include "debug.h"
+#include "error.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Nombre de passes d'attente active avant de s'endormir
+#define SPIN_ROUNDS 2048
+
+// En dessous de ce nombre de threads, le compteur central suffit
+#define CENTRAL_MAX 8
+
+#define TREE_ARITY 4
+
+// Chaque thread possède sa propre ligne de cache : son compteur d'arrivée
+// (arbre), ses drapeaux (dissémination) et sa phase courante
+struct barrier_slot
+{
+  atomic_uint arrived;
+  atomic_uint flag[32];
+  unsigned epoch;
+} __attribute__ ((aligned (64)));
+
+static inline void cpu_relax (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause ();
+#endif
+}
+
+// Attend que *w ait atteint target (les compteurs sont monotones, on compare
+// modulo 2^32)
+static void wait_for (barrier_t *b, atomic_uint *w, unsigned target)
+{
+  unsigned v;
+
+  for (int i = 0; i < SPIN_ROUNDS; i++) {
+    if ((int)(atomic_load_explicit (w, memory_order_acquire) - target) >= 0)
+      return;
+    cpu_relax ();
+  }
+
+  atomic_fetch_add (&b->sleeping, 1);
+  while ((int)((v = atomic_load (w)) - target) < 0) {
+#ifdef __linux__
+    syscall (SYS_futex, w, FUTEX_WAIT_PRIVATE, v, NULL, NULL, 0);
+#else
+    sched_yield ();
+#endif
+  }
+  atomic_fetch_sub (&b->sleeping, 1);
+}
+
+static void wake (barrier_t *b, atomic_uint *w)
+{
+#ifdef __linux__
+  if (atomic_load (&b->sleeping))
+    syscall (SYS_futex, w, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+// Libère les threads qui attendent sur b->release
+static void release (barrier_t *b, unsigned epoch)
+{
+  atomic_store (&b->release, epoch);
+  wake (b, &b->release);
+}
+
+int barrier_init (barrier_t *b, unsigned nb_threads)
+{
+  char *str = getenv ("BARRIER");
+
+  if (nb_threads == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (str == NULL)
+    b->kind = BARRIER_AUTO;
+  else if (!strcmp (str, "central"))
+    b->kind = BARRIER_CENTRAL;
+  else if (!strcmp (str, "tree"))
+    b->kind = BARRIER_TREE;
+  else if (!strcmp (str, "dissemination"))
+    b->kind = BARRIER_DISSEMINATION;
+  else
+    exit_with_error ("BARRIER: unknown barrier kind %s\n", str);
+
+  if (b->kind == BARRIER_AUTO)
+    b->kind = nb_threads <= CENTRAL_MAX ? BARRIER_CENTRAL : BARRIER_TREE;
+
+  b->nb_threads = nb_threads;
+  for (b->rounds = 0; (1u << b->rounds) < nb_threads; b->rounds++)
+    ;
+
+  atomic_init (&b->count, 0);
+  atomic_init (&b->release, 0);
+  atomic_init (&b->sleeping, 0);
+
+  b->slot = aligned_alloc (64, nb_threads * sizeof (struct barrier_slot));
+  if (b->slot == NULL)
+    return -1;
+  memset (b->slot, 0, nb_threads * sizeof (struct barrier_slot));
+
+  PRINT_DEBUG ('t', "Barrier for %u threads: %s\n", nb_threads,
+               b->kind == BARRIER_CENTRAL
+                   ? "central"
+                   : (b->kind == BARRIER_TREE ? "tree" : "dissemination"));
+
+  return 0;
+}
+
+void barrier_destroy (barrier_t *b)
+{
+  free (b->slot);
+  b->slot = NULL;
+}
+
+// Le dernier arrivé remet le compteur à zéro, appelle f puis libère les
+// autres
+static void central (barrier_t *b, unsigned epoch, void (*f) (void))
+{
+  if (atomic_fetch_add (&b->count, 1) + 1 == b->nb_threads) {
+    atomic_store_explicit (&b->count, 0, memory_order_relaxed);
+    if (f != NULL)
+      f ();
+    release (b, epoch);
+  } else
+    wait_for (b, &b->release, epoch);
+}
+
+// Chaque thread attend ses fils puis prévient son père ; la racine (thread
+// 0) appelle f et libère tout le monde
+static void tree (barrier_t *b, unsigned me, unsigned epoch, void (*f) (void))
+{
+  unsigned first    = me * TREE_ARITY + 1;
+  unsigned children = 0;
+
+  if (first < b->nb_threads)
+    children = b->nb_threads - first < TREE_ARITY ? b->nb_threads - first
+                                                  : TREE_ARITY;
+  if (children)
+    wait_for (b, &b->slot[me].arrived, epoch * children);
+
+  if (me == 0) {
+    if (f != NULL)
+      f ();
+    release (b, epoch);
+  } else {
+    atomic_uint *up = &b->slot[(me - 1) / TREE_ARITY].arrived;
+
+    atomic_fetch_add (up, 1);
+    wake (b, up);
+    wait_for (b, &b->release, epoch);
+  }
+}
+
+// Au tour r, le thread me prévient le thread me + 2^r et attend d'être
+// prévenu par me - 2^r. Au bout de log2(n) tours, tous sont arrivés.
+static void dissemination (barrier_t *b, unsigned me, unsigned epoch,
+                           void (*f) (void))
+{
+  for (unsigned r = 0; r < b->rounds; r++) {
+    atomic_uint *partner =
+        &b->slot[(me + (1u << r)) % b->nb_threads].flag[r];
+
+    atomic_fetch_add (partner, 1);
+    wake (b, partner);
+    wait_for (b, &b->slot[me].flag[r], epoch);
+  }
+
+  // Pour barrier_single, le thread 0 appelle f puis libère les autres
+  if (f != NULL) {
+    if (me == 0) {
+      f ();
+      release (b, epoch);
+    } else
+      wait_for (b, &b->release, epoch);
+  }
+}
+
+void barrier_single (barrier_t *b, unsigned me, void (*f) (void))
+{
+  unsigned epoch = ++b->slot[me].epoch;
+
+  switch (b->kind) {
+  case BARRIER_TREE:
+    tree (b, me, epoch, f);
+    break;
+  case BARRIER_DISSEMINATION:
+    dissemination (b, me, epoch, f);
+    break;
+  default:
+    central (b, epoch, f);
+  }
+}
+
+void barrier_wait (barrier_t *b, unsigned me)
+{
+  barrier_single (b, me, NULL);
+}
@@ -10,17 +10,24 @@
 #include "ocl.h"
 
 #include <assert.h>
+#include <string.h>
 
 char *pngfile = NULL;
 
 unsigned display        = 1;
 unsigned vsync          = 1;
+unsigned pbo_enabled    = 1;
 unsigned do_first_touch = 0;
 char *draw_param        = NULL;
+char *view_param        = NULL;
 
 Uint32 *restrict image = NULL, *restrict alt_image = NULL;
 unsigned DIM = 0;
 
+unsigned char *dirty_map = NULL;
+unsigned dirty_dim       = 0;
+unsigned dirty_tracking  = 0;
+
 #ifdef NOSDL
 
 #include <string.h>
@@ -70,6 +77,15 @@ int graphics_display_enabled (void)
 {
   return 0;
 }
+void graphics_redraw (void)
+{
+}
+void graphics_view_zoom (int x, int y, float factor)
+{
+}
+void graphics_view_pan (int dx, int dy)
+{
+}
 
 #else
 
@@ -82,6 +98,26 @@ static SDL_Surface *surface = NULL;
 static SDL_Texture *texture = NULL;
 // static SDL_Texture *alt_texture = NULL;
 
+// Vue réduite : lorsque l'image est plus grande que la fenêtre, on construit
+// côté CPU une image WIN_WIDTH x WIN_HEIGHT (c'est la seule que l'on envoie
+// au GPU). La vue peut être zoomée/déplacée (molette, glisser-déposer).
+enum
+{
+  VIEW_OFF,
+  VIEW_MAX,    // max des pixels de chaque bloc (= « au moins une cellule »)
+  VIEW_DENSITY // moyenne des composantes (ombrage selon la densité)
+};
+
+static unsigned view_mode   = VIEW_OFF;
+static Uint32 *view         = NULL;
+static float view_zoom      = 1.0; // >= 1 : 1 <=> toute l'image est visible
+static float view_x         = 0.0; // coin haut-gauche de la zone visible
+static float view_y         = 0.0;
+static unsigned *view_col_d = NULL; // colonnes [d, f[ de chaque pixel de vue
+static unsigned *view_col_f = NULL;
+
+#define VIEW_MAX_ZOOM 256.0
+
 static void graphics_create_surface (unsigned dim)
 {
   Uint32 rmask, gmask, bmask, amask;
@@ -162,6 +198,377 @@ void graphics_image_init (void)
     the_draw (draw_param);
 }
 
+static void graphics_view_init (void)
+{
+  if (view_param == NULL)
+    view_mode = (DIM > WIN_WIDTH || DIM > WIN_HEIGHT) ? VIEW_MAX : VIEW_OFF;
+  else if (!strcmp (view_param, "max"))
+    view_mode = VIEW_MAX;
+  else if (!strcmp (view_param, "density"))
+    view_mode = VIEW_DENSITY;
+  else if (!strcmp (view_param, "full"))
+    view_mode = VIEW_OFF;
+  else
+    exit_with_error ("Unknown view mode <%s> (max, density or full)\n",
+                     view_param);
+
+  if (view_mode != VIEW_OFF && opencl_used) {
+    // La texture est partagée avec OpenCL : elle doit faire DIM x DIM
+    printf ("Reduced view is not available with OpenCL\n");
+    view_mode = VIEW_OFF;
+  }
+
+  if (view_mode == VIEW_OFF)
+    return;
+
+  view       = malloc (WIN_WIDTH * WIN_HEIGHT * sizeof (Uint32));
+  view_col_d = malloc (WIN_WIDTH * sizeof (unsigned));
+  view_col_f = malloc (WIN_WIDTH * sizeof (unsigned));
+
+  PRINT_DEBUG ('g', "Reduced %s view: %d x %d\n",
+               view_mode == VIEW_MAX ? "max" : "density", WIN_WIDTH,
+               WIN_HEIGHT);
+}
+
+// Bornes [*d, *f[ des lignes (ou colonnes) de l'image couvertes par le pixel
+// de vue v. On prend au moins un pixel, ce qui donne un échantillonnage au
+// plus proche voisin lorsque l'on est zoomé au-delà de la taille réelle.
+static inline void view_bounds (float origin, float scale, int v, unsigned *d,
+                                unsigned *f)
+{
+  unsigned a = origin + v * scale;
+  unsigned b = origin + (v + 1) * scale;
+
+  if (a >= DIM)
+    a = DIM - 1;
+  if (b <= a)
+    b = a + 1;
+  if (b > DIM)
+    b = DIM;
+
+  *d = a;
+  *f = b;
+}
+
+static void graphics_build_view (Uint32 *restrict dest)
+{
+  const float xscale = DIM / view_zoom / WIN_WIDTH;
+  const float yscale = DIM / view_zoom / WIN_HEIGHT;
+
+  for (int vx = 0; vx < WIN_WIDTH; vx++)
+    view_bounds (view_x, xscale, vx, view_col_d + vx, view_col_f + vx);
+
+#pragma omp parallel for schedule(dynamic, 8)
+  for (int vy = 0; vy < WIN_HEIGHT; vy++) {
+    Uint32 *restrict out = dest + vy * WIN_WIDTH;
+    unsigned i_d, i_f;
+
+    view_bounds (view_y, yscale, vy, &i_d, &i_f);
+
+    if (view_mode == VIEW_MAX) {
+      memset (out, 0, WIN_WIDTH * sizeof (Uint32));
+
+      // On parcourt l'image ligne par ligne pour des accès contigus
+      for (unsigned i = i_d; i < i_f; i++) {
+        const Uint32 *restrict src = img_cell (image, i, 0);
+        for (int vx = 0; vx < WIN_WIDTH; vx++) {
+          Uint32 m = out[vx];
+          for (unsigned j = view_col_d[vx]; j < view_col_f[vx]; j++)
+            m = MAX (m, src[j]);
+          out[vx] = m;
+        }
+      }
+    } else {
+      unsigned sum[WIN_WIDTH][3];
+
+      memset (sum, 0, sizeof (sum));
+
+      for (unsigned i = i_d; i < i_f; i++) {
+        const Uint32 *restrict src = img_cell (image, i, 0);
+        for (int vx = 0; vx < WIN_WIDTH; vx++)
+          for (unsigned j = view_col_d[vx]; j < view_col_f[vx]; j++) {
+            Uint32 c = src[j];
+            sum[vx][0] += c >> 24;
+            sum[vx][1] += (c >> 16) & 0xFF;
+            sum[vx][2] += (c >> 8) & 0xFF;
+          }
+      }
+
+      for (int vx = 0; vx < WIN_WIDTH; vx++) {
+        unsigned n = (i_f - i_d) * (view_col_f[vx] - view_col_d[vx]);
+        out[vx]    = (sum[vx][0] / n) << 24 | (sum[vx][1] / n) << 16 |
+                  (sum[vx][2] / n) << 8 | 0xFF;
+      }
+    }
+  }
+}
+
+static void graphics_view_clamp (void)
+{
+  float visible = DIM / view_zoom;
+
+  view_x = MAX (0.0, MIN (view_x, DIM - visible));
+  view_y = MAX (0.0, MIN (view_y, DIM - visible));
+}
+
+// Zoom (factor > 1) ou dézoom centré sur le pixel (x, y) de la fenêtre
+void graphics_view_zoom (int x, int y, float factor)
+{
+  if (view_mode == VIEW_OFF)
+    return;
+
+  float old_scale = DIM / view_zoom / WIN_WIDTH;
+  float new_zoom  = MAX (1.0, MIN (view_zoom * factor, VIEW_MAX_ZOOM));
+
+  // Le point de l'image situé sous la souris ne doit pas bouger
+  float px = view_x + x * old_scale;
+  float py = view_y + y * (DIM / view_zoom / WIN_HEIGHT);
+
+  view_zoom = new_zoom;
+  view_x    = px - x * (DIM / view_zoom / WIN_WIDTH);
+  view_y    = py - y * (DIM / view_zoom / WIN_HEIGHT);
+
+  graphics_view_clamp ();
+}
+
+// Déplacement de la vue de (dx, dy) pixels de la fenêtre
+void graphics_view_pan (int dx, int dy)
+{
+  if (view_mode == VIEW_OFF)
+    return;
+
+  view_x += dx * (DIM / view_zoom / WIN_WIDTH);
+  view_y += dy * (DIM / view_zoom / WIN_HEIGHT);
+
+  graphics_view_clamp ();
+}
+
+// Envoi asynchrone des pixels par Pixel Buffer Objects : on copie les pixels
+// dans un PBO projeté en mémoire, puis glTexSubImage2D lit depuis ce PBO, ce
+// qui rend la main immédiatement (transfert DMA). Les PBO sont utilisés à
+// tour de rôle pour ne jamais attendre la fin du transfert précédent. À
+// défaut (extension absente, moteur de rendu autre qu'OpenGL, --no-pbo), on
+// envoie directement depuis la mémoire du processus.
+#define NB_PBO 2
+
+static GLuint pbo[NB_PBO];
+static unsigned pbo_next = 0;
+static unsigned pbo_ok   = 0;
+
+static PFNGLGENBUFFERSPROC pglGenBuffers       = NULL;
+static PFNGLDELETEBUFFERSPROC pglDeleteBuffers = NULL;
+static PFNGLBINDBUFFERPROC pglBindBuffer       = NULL;
+static PFNGLBUFFERDATAPROC pglBufferData       = NULL;
+static PFNGLMAPBUFFERPROC pglMapBuffer         = NULL;
+static PFNGLUNMAPBUFFERPROC pglUnmapBuffer     = NULL;
+
+static SDL_Rect *dirty_rects = NULL;
+
+static void graphics_pbo_init (void)
+{
+  SDL_RendererInfo info;
+
+  if (!pbo_enabled)
+    return;
+
+  if (SDL_GetRendererInfo (ren, &info) != 0 || strcmp (info.name, "opengl")) {
+    PRINT_DEBUG ('g', "PBO disabled: renderer is not OpenGL\n");
+    return;
+  }
+
+  SDL_GL_BindTexture (texture, NULL, NULL);
+
+  if (!SDL_GL_ExtensionSupported ("GL_ARB_pixel_buffer_object")) {
+    PRINT_DEBUG ('g', "PBO disabled: GL_ARB_pixel_buffer_object missing\n");
+    return;
+  }
+
+  pglGenBuffers    = SDL_GL_GetProcAddress ("glGenBuffers");
+  pglDeleteBuffers = SDL_GL_GetProcAddress ("glDeleteBuffers");
+  pglBindBuffer    = SDL_GL_GetProcAddress ("glBindBuffer");
+  pglBufferData    = SDL_GL_GetProcAddress ("glBufferData");
+  pglMapBuffer     = SDL_GL_GetProcAddress ("glMapBuffer");
+  pglUnmapBuffer   = SDL_GL_GetProcAddress ("glUnmapBuffer");
+
+  if (!pglGenBuffers || !pglDeleteBuffers || !pglBindBuffer ||
+      !pglBufferData || !pglMapBuffer || !pglUnmapBuffer) {
+    PRINT_DEBUG ('g', "PBO disabled: missing GL entry points\n");
+    return;
+  }
+
+  pglGenBuffers (NB_PBO, pbo);
+  pbo_ok = 1;
+
+  PRINT_DEBUG ('g', "Texture streaming through %d PBOs\n", NB_PBO);
+}
+
+// Renvoie l'adresse à laquelle écrire les pixels à envoyer, ou NULL si l'on
+// doit envoyer depuis la mémoire du processus. Le PBO reste lié jusqu'à
+// graphics_pbo_release ().
+static Uint32 *graphics_pbo_map (size_t size)
+{
+  Uint32 *ptr;
+
+  if (!pbo_ok)
+    return NULL;
+
+  pglBindBuffer (GL_PIXEL_UNPACK_BUFFER, pbo[pbo_next]);
+
+  // On abandonne l'ancien contenu : le pilote peut fournir un nouveau
+  // stockage sans attendre la fin d'un transfert encore en cours
+  pglBufferData (GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+  ptr = pglMapBuffer (GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+
+  if (ptr == NULL) {
+    printf ("glMapBuffer failed, falling back to synchronous uploads\n");
+    pglBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+    pglDeleteBuffers (NB_PBO, pbo);
+    pbo_ok = 0;
+  }
+
+  return ptr;
+}
+
+static void graphics_pbo_release (void)
+{
+  pglBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+  pbo_next = (pbo_next + 1) % NB_PBO;
+}
+
+// Envoie les rectangles de l'image dans la texture (liée au préalable)
+static void graphics_upload_rects (SDL_Rect *rects, unsigned nb_rect)
+{
+  Uint32 *dest;
+  size_t total = 0, base = 0;
+
+  if (nb_rect == 0)
+    return;
+
+  for (unsigned r = 0; r < nb_rect; r++)
+    total += (size_t)rects[r].w * rects[r].h;
+
+  // Le PBO ne contient que les zones modifiées, rangées les unes à la suite
+  // des autres
+  dest = graphics_pbo_map (total * sizeof (Uint32));
+
+  if (dest != NULL) {
+#pragma omp parallel
+    {
+      size_t b = 0;
+
+      for (unsigned r = 0; r < nb_rect; r++) {
+        SDL_Rect *rect = rects + r;
+#pragma omp for schedule(static) nowait
+        for (int i = rect->y; i < rect->y + rect->h; i++)
+          memcpy (dest + b + (size_t)(i - rect->y) * rect->w,
+                  img_cell (image, i, rect->x), rect->w * sizeof (Uint32));
+        b += (size_t)rect->w * rect->h;
+      }
+    }
+
+    pglUnmapBuffer (GL_PIXEL_UNPACK_BUFFER);
+  }
+
+  glPixelStorei (GL_UNPACK_ROW_LENGTH, dest ? 0 : DIM);
+
+  for (unsigned r = 0; r < nb_rect; r++) {
+    SDL_Rect *rect = rects + r;
+    size_t offset  = (size_t)rect->y * DIM + rect->x;
+
+    glTexSubImage2D (GL_TEXTURE_2D, 0,          /* mipmap level */
+                     rect->x, rect->y,          /* x, y */
+                     rect->w, rect->h,          /* width, height */
+                     GL_RGBA, GL_UNSIGNED_INT_8_8_8_8,
+                     dest ? (void *)(base * sizeof (Uint32))
+                          : (void *)(image + offset));
+    base += (size_t)rect->w * rect->h;
+  }
+
+  glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+
+  if (dest != NULL)
+    graphics_pbo_release ();
+}
+
+static void graphics_upload_view (void)
+{
+  Uint32 *dest;
+
+  // La réduction relit ce qu'elle écrit : on la construit dans view, le PBO
+  // projeté en écriture seule ne reçoit qu'une copie
+  graphics_build_view (view);
+
+  dest = graphics_pbo_map (WIN_WIDTH * WIN_HEIGHT * sizeof (Uint32));
+
+  if (dest != NULL) {
+    memcpy (dest, view, WIN_WIDTH * WIN_HEIGHT * sizeof (Uint32));
+    pglUnmapBuffer (GL_PIXEL_UNPACK_BUFFER);
+  }
+
+  glTexSubImage2D (GL_TEXTURE_2D, 0,      /* mipmap level */
+                   0, 0,                  /* x, y */
+                   WIN_WIDTH, WIN_HEIGHT, /* width, height */
+                   GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, dest ? NULL : view);
+
+  if (dest != NULL)
+    graphics_pbo_release ();
+}
+
+static inline void add_rect (SDL_Rect *rect, int y, int x, int h, int w)
+{
+  rect->x = x;
+  rect->y = y;
+  rect->w = MIN (w, (int)DIM - x);
+  rect->h = MIN (h, (int)DIM - y);
+}
+
+// Construit la liste des zones à envoyer à partir des tuiles signalées comme
+// modifiées. Les tuiles consécutives d'une même ligne sont regroupées en
+// segments, et un segment identique sur les lignes suivantes prolonge le
+// rectangle : un seul glTexSubImage2D par rectangle.
+static unsigned graphics_collect_dirty_rects (SDL_Rect *rects)
+{
+  unsigned open_end[dirty_dim]; // rectangle ouvert commençant à la colonne c
+  unsigned open_row[dirty_dim]; // ... depuis la ligne open_row[c]
+  unsigned run_end[dirty_dim];  // segments de la ligne courante
+  unsigned nb_rect = 0;
+
+  memset (open_end, 0, sizeof (open_end));
+
+  for (unsigned r = 0; r <= dirty_dim; r++) {
+    memset (run_end, 0, sizeof (run_end));
+
+    if (r < dirty_dim) {
+      unsigned char *line = dirty_map + r * dirty_dim;
+      for (unsigned c = 0; c < dirty_dim; c++)
+        if (line[c]) {
+          unsigned d = c;
+          while (c < dirty_dim && line[c])
+            line[c++] = 0;
+          run_end[d] = c;
+        }
+    }
+
+    for (unsigned c = 0; c < dirty_dim; c++) {
+      // Le rectangle ouvert ne se prolonge pas : on le ferme
+      if (open_end[c] && open_end[c] != run_end[c]) {
+        add_rect (rects + nb_rect++, open_row[c] * DIRTY_TILE, c * DIRTY_TILE,
+                  (r - open_row[c]) * DIRTY_TILE,
+                  (open_end[c] - c) * DIRTY_TILE);
+        open_end[c] = 0;
+      }
+      if (run_end[c] && !open_end[c]) {
+        open_end[c] = run_end[c];
+        open_row[c] = r;
+      }
+    }
+  }
+
+  PRINT_DEBUG ('g', "%u dirty rectangle(s) to upload\n", nb_rect);
+
+  return nb_rect;
+}
+
 void graphics_init ()
 {
   Uint32 render_flags =
@@ -218,12 +625,31 @@ void graphics_init ()
   }
 #endif
 
+  if (display)
+    graphics_view_init ();
+
+  // La carte des tuiles modifiées n'a de sens que si l'on envoie l'image
+  // complète dans la texture
+  if (display && view_mode == VIEW_OFF && !opencl_used) {
+    dirty_dim = (DIM + DIRTY_TILE - 1) / DIRTY_TILE;
+    dirty_map = calloc (dirty_dim * dirty_dim, sizeof (unsigned char));
+    dirty_rects = malloc (dirty_dim * dirty_dim * sizeof (SDL_Rect));
+  }
+
   // Création d'une texture à partir de la surface
   // texture = SDL_CreateTextureFromSurface (ren, surface);
-  texture = SDL_CreateTexture (
-      ren, SDL_PIXELFORMAT_RGBA8888, // SDL_PIXELFORMAT_RGBA32,
-      SDL_TEXTUREACCESS_STATIC, DIM, DIM);
+  if (view_mode == VIEW_OFF)
+    texture = SDL_CreateTexture (
+        ren, SDL_PIXELFORMAT_RGBA8888, // SDL_PIXELFORMAT_RGBA32,
+        SDL_TEXTUREACCESS_STATIC, DIM, DIM);
+  else
+    texture = SDL_CreateTexture (ren, SDL_PIXELFORMAT_RGBA8888,
+                                 SDL_TEXTUREACCESS_STATIC, WIN_WIDTH,
+                                 WIN_HEIGHT);
   PRINT_DEBUG ('g', "DIM = %d\n", DIM);
+
+  if (display && !opencl_used)
+    graphics_pbo_init ();
 }
 
 void graphics_share_texture_buffers (void)
@@ -250,16 +676,21 @@ void graphics_render_image (void)
   } else {
     SDL_GL_BindTexture (texture, NULL, NULL);
 
-    glTexSubImage2D (GL_TEXTURE_2D, 0, /* mipmap level */
-                     0, 0,             /* x, y */
-                     DIM, DIM,         /* width, height */
-                     GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, image);
+    if (view_mode != VIEW_OFF)
+      graphics_upload_view ();
+    else if (dirty_tracking)
+      graphics_upload_rects (dirty_rects,
+                             graphics_collect_dirty_rects (dirty_rects));
+    else {
+      SDL_Rect all = {0, 0, DIM, DIM};
+      graphics_upload_rects (&all, 1);
+    }
   }
 
   src.x = 0;
   src.y = 0;
-  src.w = DIM;
-  src.h = DIM;
+  src.w = (view_mode == VIEW_OFF) ? DIM : WIN_WIDTH;
+  src.h = (view_mode == VIEW_OFF) ? DIM : WIN_HEIGHT;
 
   // On redimensionne l'image pour qu'elle occupe toute la fenêtre
   dst.x = 0;
@@ -292,6 +723,15 @@ void graphics_refresh (void)
 #endif
 }
 
+// Réaffiche l'image courante sans toucher au monitoring (utilisé lorsque
+// seule la vue change)
+void graphics_redraw (void)
+{
+  SDL_RenderClear (ren);
+  graphics_render_image ();
+  SDL_RenderPresent (ren);
+}
+
 typedef struct
 {
   uint16_t magic;       /* Magic identifier: "BM" */
@@ -373,6 +813,20 @@ void graphics_clean (void)
   if (surface != NULL)
     SDL_FreeSurface (surface);
 
+  if (dirty_map != NULL) {
+    free (dirty_map);
+    free (dirty_rects);
+  }
+
+  if (pbo_ok)
+    pglDeleteBuffers (NB_PBO, pbo);
+
+  if (view != NULL) {
+    free (view);
+    free (view_col_d);
+    free (view_col_f);
+  }
+
   if (display) {
     if (texture != NULL)
       SDL_DestroyTexture (texture);
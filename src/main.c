@@ -7,6 +7,7 @@
 #include <SDL.h>
 #endif
 
+#include "autotune.h"
 #include "compute.h"
 #include "constants.h"
 #include "debug.h"
@@ -15,6 +16,11 @@
 #include "graphics.h"
 #include "monitoring.h"
 #include "ocl.h"
+#include "perf.h"
+#include "phases.h"
+#include "roofline.h"
+#include "trace.h"
+#include "validate.h"
 
 // Returns duration in µsecs
 #define TIME_DIFF(t1, t2)                                                      \
@@ -23,6 +29,7 @@
 static char *progname    = NULL;
 int max_iter             = 0;
 unsigned refresh_rate    = 1;
+unsigned frame_budget    = 0;
 unsigned GRAIN           = 8;
 static unsigned do_pause = 0;
 static unsigned nb_cores = 1;
@@ -30,14 +37,17 @@ char *version            = DEFAULT_VARIANT;
 char *kernel             = DEFAULT_KERNEL;
 unsigned opencl_used     = 0;
 static unsigned do_dump  = 0;
+static unsigned refresh_rate_set = 0;
 
 static hwloc_topology_t topology;
+static hwloc_bitmap_t initial_binding; // placement du thread principal
 
 void_func_t the_first_touch = NULL;
 void_func_t the_init        = NULL;
 draw_func_t the_draw        = NULL;
 void_func_t the_finalize    = NULL;
 int_func_t the_compute      = NULL;
+int_func_t the_refine       = NULL;
 void_func_t the_refresh_img = NULL;
 
 unsigned get_nb_cores (void)
@@ -45,6 +55,22 @@ unsigned get_nb_cores (void)
   return nb_cores;
 }
 
+// Fixe le thread appelant sur l'unité de calcul c (modulo leur nombre)
+void pin_current_thread (unsigned c)
+{
+  hwloc_obj_t obj =
+      hwloc_get_obj_by_type (topology, HWLOC_OBJ_PU, c % nb_cores);
+
+  if (obj != NULL)
+    hwloc_set_cpubind (topology, obj->cpuset, HWLOC_CPUBIND_THREAD);
+}
+
+// Rend au thread appelant le placement qu'avait le programme au démarrage
+void unpin_current_thread (void)
+{
+  hwloc_set_cpubind (topology, initial_binding, HWLOC_CPUBIND_THREAD);
+}
+
 #ifdef ENABLE_MPI
 #include <mpi.h>
 
@@ -83,13 +109,19 @@ static void usage (int val)
   fprintf (
       stderr,
       "\t-a\t| --arg <string>\t: pass argument <string> to draw function\n");
+  fprintf (stderr, "\t-at\t| --autotune\t\t: search the best variant, grain, "
+                   "schedule and thread count (then use -v auto)\n");
   fprintf (
       stderr,
       "\t-d\t| --debug-flags <flags>\t: enable debug messages (see debug.h)\n");
   fprintf (stderr, "\t-du\t| --dump\t\t: dump final image to disk\n");
+  fprintf (stderr, "\t-fb\t| --frame-budget <ms>\t: time slice of each "
+                   "progressive refinement step (default 20)\n");
   fprintf (stderr,
            "\t-ft\t| --first-touch\t\t: touch memory on different cores\n");
   fprintf (stderr, "\t-g\t| --grain <G>\t\t: use G x G tiles\n");
+  fprintf (stderr, "\t-gd\t| --golden <file>\t: validate against (or record) "
+                   "hashes stored in <file>\n");
   fprintf (stderr, "\t-h\t| --help\t\t: display help\n");
   fprintf (stderr, "\t-i\t| --iterations <n>\t: stop after n iterations\n");
   fprintf (stderr,
@@ -99,14 +131,28 @@ static void usage (int val)
            "\t-m \t| --monitoring\t\t: enable graphical thread monitoring\n");
   fprintf (stderr,
            "\t-n\t| --no-display\t\t: avoid graphical display overhead\n");
+  fprintf (stderr, "\t-npbo\t| --no-pbo\t\t: synchronous texture uploads "
+                   "(no pixel buffer objects)\n");
   fprintf (stderr, "\t-o\t| --ocl\t\t\t: use OpenCL version\n");
+  fprintf (stderr, "\t-ph\t| --phases <file>\t: dump latency histograms of "
+                   "each phase of the main loop\n");
+  fprintf (stderr, "\t-pc\t| --perf-counters <list>\t: report hardware "
+                   "counters (e.g. cycles,instructions,LLC-misses or list)\n");
   fprintf (stderr, "\t-p\t| --pause\t\t: pause between iterations (press space "
                    "to continue)\n");
   fprintf (stderr,
            "\t-r\t| --refresh-rate <N>\t: display only 1/Nth of images\n");
+  fprintf (stderr, "\t-rl\t| --roofline\t\t: compare the run with the "
+                   "machine's bandwidth and peak op rate\n");
   fprintf (stderr, "\t-s\t| --size <DIM>\t\t: use image of size DIM x DIM\n");
+  fprintf (stderr, "\t-tr\t| --trace <prefix>\t: record computed tiles into "
+                   "<prefix>.json and <prefix>.paje\n");
   fprintf (stderr,
            "\t-v\t| --version <name>\t: select version <name> of algorithm\n");
+  fprintf (stderr, "\t-val\t| --validate <k>\t: compare with seq version every "
+                   "k iterations\n");
+  fprintf (stderr, "\t-vw\t| --view <mode>\t\t: reduced view of large images "
+                   "(max, density or full)\n");
 
   exit (val);
 }
@@ -122,6 +168,8 @@ static void filter_args (int *argc, char *argv[])
   while (*argc > 0) {
     if (!strcmp (*argv, "--no-vsync") || !strcmp (*argv, "-nvs")) {
       vsync = 0;
+    } else if (!strcmp (*argv, "--no-pbo") || !strcmp (*argv, "-npbo")) {
+      pbo_enabled = 0;
     } else if (!strcmp (*argv, "--no-display") || !strcmp (*argv, "-n")) {
       display = 0;
     } else if (!strcmp (*argv, "--pause") || !strcmp (*argv, "-p")) {
@@ -132,8 +180,22 @@ static void filter_args (int *argc, char *argv[])
       do_first_touch = 1;
     } else if (!strcmp (*argv, "--monitoring") || !strcmp (*argv, "-m")) {
       do_monitoring = 1;
+    } else if (!strcmp (*argv, "--autotune") || !strcmp (*argv, "-at")) {
+      do_autotune = 1;
+      display     = 0;
+    } else if (!strcmp (*argv, "--roofline") || !strcmp (*argv, "-rl")) {
+      do_roofline = 1;
+      display     = 0;
     } else if (!strcmp (*argv, "--dump") || !strcmp (*argv, "-du")) {
       do_dump = 1;
+    } else if (!strcmp (*argv, "--frame-budget") || !strcmp (*argv, "-fb")) {
+      if (*argc == 1) {
+        fprintf (stderr, "Error: budget missing\n");
+        usage (1);
+      }
+      (*argc)--;
+      argv++;
+      frame_budget = atoi (*argv);
     } else if (!strcmp (*argv, "--arg") || !strcmp (*argv, "-a")) {
       if (*argc == 1) {
         fprintf (stderr, "Error: parameter string missing\n");
@@ -142,6 +204,61 @@ static void filter_args (int *argc, char *argv[])
       (*argc)--;
       argv++;
       draw_param = *argv;
+    } else if (!strcmp (*argv, "--validate") || !strcmp (*argv, "-val")) {
+      if (*argc == 1) {
+        fprintf (stderr, "Error: validation period missing\n");
+        usage (1);
+      }
+      (*argc)--;
+      argv++;
+      validate_period = atoi (*argv);
+      if (validate_period == 0)
+        validate_period = 1;
+      display = 0;
+    } else if (!strcmp (*argv, "--golden") || !strcmp (*argv, "-gd")) {
+      if (*argc == 1) {
+        fprintf (stderr, "Error: filename missing\n");
+        usage (1);
+      }
+      (*argc)--;
+      argv++;
+      validate_golden = *argv;
+      if (validate_period == 0)
+        validate_period = 1;
+      display = 0;
+    } else if (!strcmp (*argv, "--view") || !strcmp (*argv, "-vw")) {
+      if (*argc == 1) {
+        fprintf (stderr, "Error: view mode missing\n");
+        usage (1);
+      }
+      (*argc)--;
+      argv++;
+      view_param = *argv;
+    } else if (!strcmp (*argv, "--phases") || !strcmp (*argv, "-ph")) {
+      if (*argc == 1) {
+        fprintf (stderr, "Error: filename missing\n");
+        usage (1);
+      }
+      (*argc)--;
+      argv++;
+      phases_file = *argv;
+    } else if (!strcmp (*argv, "--perf-counters") || !strcmp (*argv, "-pc")) {
+      if (*argc == 1) {
+        fprintf (stderr, "Error: counter list missing\n");
+        usage (1);
+      }
+      (*argc)--;
+      argv++;
+      perf_param = *argv;
+    } else if (!strcmp (*argv, "--trace") || !strcmp (*argv, "-tr")) {
+      if (*argc == 1) {
+        fprintf (stderr, "Error: trace prefix missing\n");
+        usage (1);
+      }
+      (*argc)--;
+      argv++;
+      trace_prefix = *argv;
+      do_trace     = 1;
     } else if (!strcmp (*argv, "--ocl") || !strcmp (*argv, "-o")) {
       opencl_used = 1;
     } else if (!strcmp (*argv, "--kernel") || !strcmp (*argv, "-k")) {
@@ -203,7 +320,8 @@ static void filter_args (int *argc, char *argv[])
       }
       (*argc)--;
       argv++;
-      refresh_rate = atoi (*argv);
+      refresh_rate     = atoi (*argv);
+      refresh_rate_set = 1;
     } else if (!strcmp (*argv, "--debug-flags") || !strcmp (*argv, "-d")) {
       if (*argc == 1) {
         fprintf (stderr, "Error: flag list missing\n");
@@ -249,6 +367,9 @@ static void bind_functions (void)
   if (k != NULL)
     kernel = k;
 
+  if (!strcmp (version, "auto"))
+    autotune_load ();
+
   printf ("Using kernel [%s], variant [%s]\n", kernel, version);
 
   the_compute = bind_it (kernel, "compute", version, !opencl_used);
@@ -265,6 +386,7 @@ static void bind_functions (void)
   the_draw        = bind_it (kernel, "draw", version, 0);
   the_finalize    = bind_it (kernel, "finalize", version, 0);
   the_refresh_img = bind_it (kernel, "refresh_img", version, 0);
+  the_refine      = bind_it (kernel, "refine", version, 0);
 
   if (!opencl_used) {
     the_first_touch = bind_it (kernel, "ft", version, do_first_touch);
@@ -286,6 +408,7 @@ int main (int argc, char **argv)
   int stable     = 0;
   int iterations = 0;
   unsigned step  = 0;
+  int failed     = 0;
 
 #ifdef ENABLE_MPI
   mpi_init (&argc, &argv);
@@ -299,22 +422,46 @@ int main (int argc, char **argv)
   hwloc_topology_load (topology);
 
   nb_cores = hwloc_get_nbobjs_by_type (topology, HWLOC_OBJ_PU);
+
+  initial_binding = hwloc_bitmap_alloc ();
+  if (hwloc_get_cpubind (topology, initial_binding, HWLOC_CPUBIND_THREAD))
+    hwloc_bitmap_copy (initial_binding,
+                       hwloc_topology_get_complete_cpuset (topology));
+
   PRINT_DEBUG ('t', "%d-core machine detected\n", nb_cores);
 
   bind_functions ();
 
+  if (do_autotune)
+    return autotune_run (progname);
+
+  perf_init ();
+
   if (the_init != NULL)
     the_init ();
 
   graphics_init ();
   // Now we know the value of DIM
 
+  // Affinage progressif : seulement avec affichage, sinon the_compute
+  // calcule des images complètes
+  if (the_refine == NULL || !graphics_display_enabled ())
+    frame_budget = 0;
+  else if (frame_budget == 0)
+    frame_budget = 20;
+
   if (opencl_used) {
     ocl_init ();
     ocl_send_image (image);
   }
 
-  if (graphics_display_enabled ()) {
+  trace_init ();
+  roofline_init ();
+
+  if (validate_period) {
+    // Validation de la variante
+    failed = validate_run (&iterations);
+  } else if (graphics_display_enabled ()) {
     // version graphique
 
     unsigned long temps = 0;
@@ -325,21 +472,32 @@ int main (int argc, char **argv)
 
     graphics_refresh ();
 
+    uint64_t frame = phases_now ();
+#ifndef NOSDL
+    unsigned refining = 0; // the_refine a encore du travail
+#endif
+
     for (int quit = 0; !quit;) {
 
       int r = 0;
+      uint64_t t;
 
       if (do_pause) {
         printf ("=== itération %d ===\n", iterations);
         step = 1;
       }
 
+      t = phases_now ();
+
 #ifndef NOSDL
       // Récupération éventuelle des événements clavier, souris, etc.
       do {
         SDL_Event evt;
+        int view_changed = 0;
 
-        r = get_event (&evt, step);
+        // Tant que l'image affichée n'est pas entièrement affinée, on
+        // n'attend pas les événements
+        r = get_event (&evt, step && !refining);
 
         if (r > 0)
           switch (evt.type) {
@@ -370,11 +528,48 @@ int main (int argc, char **argv)
             }
             break;
 
+          case SDL_MOUSEWHEEL: {
+            // Zoom de la vue réduite autour du pointeur de la souris
+            int x, y;
+            SDL_GetMouseState (&x, &y);
+            graphics_view_zoom (x, y, evt.wheel.y > 0 ? 1.25 : 0.8);
+            view_changed = 1;
+            break;
+          }
+
+          case SDL_MOUSEMOTION:
+            // Déplacement de la vue par glisser-déposer
+            if (evt.motion.state & SDL_BUTTON_LMASK) {
+              graphics_view_pan (-evt.motion.xrel, -evt.motion.yrel);
+              view_changed = 1;
+            }
+            break;
+
           default:;
           }
 
+        // On ne réaffiche qu'une fois les événements en attente traités
+        if (view_changed && !SDL_PollEvent (NULL))
+          graphics_redraw ();
+
+        // Plus d'événement en attente : une tranche d'affinage. En pause,
+        // on continue jusqu'à l'image complète ; sinon, l'image suivante
+        // abandonne ce qui reste.
+        if (r == 0 && refining && !quit) {
+          uint64_t t0 = phases_now ();
+
+          refining = the_refine (frame_budget);
+          t0       = phases_record (PHASE_REFINE, t0);
+          if (the_refresh_img)
+            the_refresh_img ();
+          graphics_refresh ();
+          phases_record (PHASE_RENDER, t0);
+        }
+
       } while ((r || step) && !quit);
 #endif // NOSDL
+      t = phases_record (PHASE_EVENTS, t);
+
       if (!stable && !quit) {
         if (max_iter && iterations >= max_iter) {
           if (debug_enabled ('t'))
@@ -384,6 +579,7 @@ int main (int argc, char **argv)
             printf ("Arrêt après %d itérations\n", max_iter);
           stable = 1;
           graphics_refresh ();
+          phases_record (PHASE_RENDER, t);
         } else {
           int n;
 
@@ -391,9 +587,14 @@ int main (int argc, char **argv)
             long duree_iteration;
 
             gettimeofday (&t1, NULL);
+            perf_start ();
             n = the_compute (refresh_rate);
-            if (opencl_used)
+            t = phases_record (PHASE_COMPUTE, t);
+            if (opencl_used) {
               ocl_wait ();
+              t = phases_record (PHASE_SYNC, t);
+            }
+            perf_stop (n > 0 ? n : refresh_rate);
             gettimeofday (&t2, NULL);
 
             duree_iteration = TIME_DIFF (t1, t2);
@@ -406,8 +607,12 @@ int main (int argc, char **argv)
                      (duree_iteration / nbiter) % 1000,
                      temps / 1000 / (nbiter + iterations),
                      (temps / (nbiter + iterations)) % 1000);
-          } else
+          } else {
+            perf_start ();
             n = the_compute (refresh_rate);
+            perf_stop (n > 0 ? n : refresh_rate);
+            t = phases_record (PHASE_COMPUTE, t);
+          }
 
           if (n > 0) {
             iterations += n;
@@ -421,11 +626,20 @@ int main (int argc, char **argv)
           } else
             iterations += refresh_rate;
 
-          if (the_refresh_img)
+          if (the_refresh_img) {
             the_refresh_img ();
+            t = phases_record (PHASE_REFRESH_IMG, t);
+          }
           graphics_refresh ();
+          phases_record (PHASE_RENDER, t);
+
+#ifndef NOSDL
+          refining = frame_budget != 0;
+#endif
         }
       }
+
+      frame = phases_record (PHASE_FRAME, frame);
     }
   } else {
     // Version non graphique
@@ -433,7 +647,8 @@ int main (int argc, char **argv)
     struct timeval t1, t2;
     int n;
 
-    if (max_iter)
+    // Un seul appel à the_compute, sauf si -r a été donné explicitement
+    if (max_iter && !refresh_rate_set)
       refresh_rate = max_iter;
 
     gettimeofday (&t1, NULL);
@@ -443,23 +658,37 @@ int main (int argc, char **argv)
         printf ("Arrêt après %d itérations\n", max_iter);
         stable = 1;
       } else {
-        n = the_compute (refresh_rate);
+        unsigned nb_iter = refresh_rate;
+        uint64_t t       = phases_now ();
+
+        if (max_iter && iterations + nb_iter > max_iter)
+          nb_iter = max_iter - iterations;
+
+        perf_start ();
+        n = the_compute (nb_iter);
+        perf_stop (n > 0 ? n : nb_iter);
+        phases_record (PHASE_COMPUTE, t);
         if (n > 0) {
           iterations += n;
           stable = 1;
           printf ("Calcul terminé en %d itérations\n", iterations);
         } else
-          iterations += refresh_rate;
+          iterations += nb_iter;
       }
     }
 
-    if (opencl_used)
+    if (opencl_used) {
+      uint64_t t = phases_now ();
       ocl_wait ();
+      phases_record (PHASE_SYNC, t);
+    }
 
     gettimeofday (&t2, NULL);
 
     temps = TIME_DIFF (t1, t2);
     fprintf (stderr, "%ld.%03ld\n", temps / 1000, temps % 1000);
+
+    roofline_report (temps, iterations);
   }
 
   // Check if final image should be dumped on disk
@@ -470,12 +699,20 @@ int main (int argc, char **argv)
     if (opencl_used)
       ocl_retrieve_image (image);
 
+    // En mode non graphique, the_refresh_img n'a pas encore été appelé
+    if (the_refresh_img != NULL && !graphics_display_enabled ())
+      the_refresh_img ();
+
     sprintf (filename, "dump-%s-%s-dim-%d-iter-%d.png", kernel, version, DIM,
              iterations);
 
     graphics_dump_image_to_file (filename);
   }
 
+  phases_finalize ();
+  perf_finalize ();
+  trace_finalize ();
+
 #ifdef ENABLE_MONITORING
   if (do_monitoring)
     monitoring_clean ();
@@ -486,5 +723,5 @@ int main (int argc, char **argv)
   if (the_finalize != NULL)
     the_finalize ();
 
-  return 0;
+  return failed ? EXIT_FAILURE : 0;
 }
@@ -1,16 +1,21 @@
 
+#include "barrier.h"
 #include "compute.h"
 #include "debug.h"
+#include "error.h"
 #include "global.h"
 #include "graphics.h"
 #include "monitoring.h"
 #include "ocl.h"
-#include "pthread_barrier.h"
+#include "perf.h"
+#include "phases.h"
 #include "pthread_distrib.h"
 #include "scheduler.h"
 
+#include <math.h>
 #include <omp.h>
 #include <stdbool.h>
+#include <string.h>
 
 #ifdef ENABLE_VECTO
 #include <immintrin.h>
@@ -47,62 +52,202 @@ static unsigned iteration_to_color (unsigned iter)
   return (r << 24) | (g << 16) | (b << 8) | 255 /* alpha */;
 }
 
-// Cadre initial
+// Les noyaux ne rangent que le nombre d'itérations de chaque pixel, dans
+// alt_image dont mandel ne se sert pas par ailleurs. mandel_refresh_img les
+// convertit ensuite en couleurs à l'aide d'une palette précalculée : changer
+// de palette ne demande pas de refaire le calcul.
+#define cur_iter(y, x) next_img (y, x)
+
+static Uint32 palette[MAX_ITERATIONS + 1];
+
+// Cadre initial, en long double pour les zooms profonds (versions f64 et
+// pert) ; les versions float en tirent leur cadre_t
 #if 0
 // Config 1
-static float leftX = -0.744;
-static float rightX = -0.7439;
-static float topY = .146;
-static float bottomY = .1459;
+static long double leftX = -0.744;
+static long double rightX = -0.7439;
+static long double topY = .146;
+static long double bottomY = .1459;
 #endif
 
 #if 1
 // Config 2
-static float leftX   = -0.2395;
-static float rightX  = -0.2275;
-static float topY    = .660;
-static float bottomY = .648;
+static long double leftX   = -0.2395;
+static long double rightX  = -0.2275;
+static long double topY    = .660;
+static long double bottomY = .648;
 #endif
 
 #if 0
 // Config 3
-static float leftX = -0.13749;
-static float rightX = -0.13715;
-static float topY = .64975;
-static float bottomY = .64941;
+static long double leftX = -0.13749;
+static long double rightX = -0.13715;
+static long double topY = .64975;
+static long double bottomY = .64941;
 #endif
 
-static float xstep;
-static float ystep;
+static long double xstep;
+static long double ystep;
+
+// Cadrage figé d'une image : la version pipelinée (sched_pipe) calcule
+// plusieurs images à la fois, chacune avec le sien
+typedef struct
+{
+  float leftX, topY, xstep, ystep;
+} cadre_t;
+
+static inline cadre_t cadre_courant (void)
+{
+  return (cadre_t){leftX, topY, xstep, ystep};
+}
+
+// Fraction de la largeur retirée de chaque côté à chaque image (négative :
+// on s'éloigne). La variable d'environnement ZOOM_SPEED remplace la valeur
+// par défaut.
+static double vitesse_zoom (void)
+{
+  static double vitesse = 0;
+  static int lue        = 0;
+
+  if (!lue) {
+    char *str = getenv ("ZOOM_SPEED");
+
+    vitesse = str != NULL ? atof (str) : ZOOM_SPEED;
+    lue     = 1;
+  }
+
+  return vitesse;
+}
 
 static void zoom (void)
 {
-  float xrange = (rightX - leftX);
-  float yrange = (topY - bottomY);
+  long double xrange = (rightX - leftX);
+  long double yrange = (topY - bottomY);
+  double speed       = vitesse_zoom ();
 
-  leftX += ZOOM_SPEED * xrange;
-  rightX -= ZOOM_SPEED * xrange;
-  topY -= ZOOM_SPEED * yrange;
-  bottomY += ZOOM_SPEED * yrange;
+  leftX += speed * xrange;
+  rightX -= speed * xrange;
+  topY -= speed * yrange;
+  bottomY += speed * yrange;
 
   xstep = (rightX - leftX) / DIM;
   ystep = (topY - bottomY) / DIM;
+
+  trace_next_iteration ();
 }
 
 void mandel_init ()
 {
   xstep = (rightX - leftX) / DIM;
   ystep = (topY - bottomY) / DIM;
+
+  for (unsigned n = 0; n <= MAX_ITERATIONS; n++)
+    palette[n] = iteration_to_color (n);
 }
 
-static unsigned compute_one_pixel (int i, int j)
+// Sauvegarde (save != 0) ou restauration du cadrage courant : --validate
+// exécute la version de référence et la variante sur le même cadrage
+void mandel_validate_state (int save)
+{
+  static long double saved[6];
+
+  if (save) {
+    saved[0] = leftX;
+    saved[1] = rightX;
+    saved[2] = topY;
+    saved[3] = bottomY;
+    saved[4] = xstep;
+    saved[5] = ystep;
+  } else {
+    leftX   = saved[0];
+    rightX  = saved[1];
+    topY    = saved[2];
+    bottomY = saved[3];
+    xstep   = saved[4];
+    ystep   = saved[5];
+  }
+}
+
+// Variante dont les résultats doivent être identiques, bit à bit, à ceux de
+// variant (utilisé par --autotune). Les variantes vectorielles (FMA)
+// n'arrondissent pas comme seq : elles sont comparées à vec. NULL : aucune
+// référence exacte.
+const char *mandel_reference (const char *variant)
+{
+  static const char *scalar[] = {"seq", "ms", "omp_ms", "sched_ms", "prog"};
+
+  for (int v = 0; v < sizeof (scalar) / sizeof (scalar[0]); v++)
+    if (!strcmp (variant, scalar[v]))
+      return "seq";
+
+  if (strstr (variant, "f64") != NULL)
+    return "f64";
+  if (strstr (variant, "pert") != NULL)
+    return "pert";
+  if (strstr (variant, "ocl") != NULL)
+    return NULL;
+
+#ifdef ENABLE_VECTO
+  return "vec";
+#else
+  return "seq";
+#endif
+}
+
+// Coloriage des nombres d'itérations, ligne par ligne
+void mandel_refresh_img ()
+{
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < DIM; i++) {
+    const Uint32 *it = &cur_iter (i, 0);
+    Uint32 *dst      = &cur_img (i, 0);
+    int j            = 0;
+
+#if defined(ENABLE_VECTO) && VEC_SIZE == 8
+    const __m256i max = _mm256_set1_epi32 (MAX_ITERATIONS);
+
+    for (; j + 8 <= DIM; j += 8) {
+      __m256i n = _mm256_loadu_si256 ((const __m256i *)(it + j));
+
+      n = _mm256_min_epu32 (n, max);
+      _mm256_storeu_si256 ((__m256i *)(dst + j),
+                           _mm256_i32gather_epi32 ((const int *)palette, n, 4));
+    }
+#endif
+    for (; j < DIM; j++)
+      dst[j] = palette[it[j] < MAX_ITERATIONS ? it[j] : MAX_ITERATIONS];
+  }
+}
+
+// Les points de la cardioïde principale et du bourgeon de période 2 ne
+// s'échappent jamais : inutile de calculer leur suite
+static inline int interieur (float cr, float ci)
+{
+  float ci2 = ci * ci;
+  float x   = cr - 0.25f;
+  float q   = x * x + ci2;
+
+  return q * (q + x) <= 0.25f * ci2 ||
+         (cr + 1.0f) * (cr + 1.0f) + ci2 <= 0.0625f;
+}
+
+// Renvoie le nombre d'itérations du pixel (MAX_ITERATIONS s'il ne s'échappe
+// pas) ; *faites reçoit le nombre d'itérations réellement calculées, plus
+// petit pour les pixels intérieurs et les cycles détectés
+static inline unsigned suite_pixel (const cadre_t *c, int i, int j,
+                                    unsigned *faites)
 {
-  float cr = leftX + xstep * j;
-  float ci = topY - ystep * i;
+  float cr = c->leftX + c->xstep * j;
+  float ci = c->topY - c->ystep * i;
   float zr = 0.0, zi = 0.0;
+  float sr = 0.0, si = 0.0;
 
   int iter;
 
+  *faites = 0;
+  if (interieur (cr, ci))
+    return MAX_ITERATIONS;
+
   // Pour chaque pixel, on calcule les termes d'une suite, et on
   // s'arrête lorsque |Z| > 2 ou lorsqu'on atteint MAX_ITERATIONS
   for (iter = 0; iter < MAX_ITERATIONS; iter++) {
@@ -117,11 +262,64 @@ static unsigned compute_one_pixel (int i, int j)
     /* Z = Z^2 + C */
     zr = x2 - y2 + cr;
     zi = twoxy + ci;
+
+    // Détection de cycle à la Brent : on mémorise Z aux itérations 2^k. Si
+    // la suite (déterministe) repasse exactement par ce point, elle boucle
+    // et ne s'échappera jamais.
+    if (zr == sr && zi == si) {
+      *faites = iter + 1;
+      return MAX_ITERATIONS;
+    }
+    if (((iter + 1) & iter) == 0) {
+      sr = zr;
+      si = zi;
+    }
   }
 
+  *faites = iter;
   return iter;
 }
 
+static unsigned compute_one_pixel_cadre (const cadre_t *c, int i, int j)
+{
+  unsigned faites;
+
+  return suite_pixel (c, i, j, &faites);
+}
+
+static unsigned compute_one_pixel (int i, int j)
+{
+  cadre_t c = cadre_courant ();
+
+  return compute_one_pixel_cadre (&c, i, j);
+}
+
+// Coût d'une cellule pour --roofline : l'écriture du pixel (plus
+// l'allocation de la ligne), 10 opérations flottantes pour le test de la
+// cardioïde et du bourgeon, puis 8 par itération effectivement calculée (les
+// pixels intérieurs et les cycles détectés s'arrêtent avant MAX_ITERATIONS).
+// Le nombre moyen d'itérations est estimé sur un échantillon du cadrage
+// courant.
+void mandel_roofline (double *bytes, double *int_ops, double *flops)
+{
+  const int step = DIM < 64 ? 1 : DIM / 64;
+  cadre_t c      = cadre_courant ();
+  unsigned long iter = 0, n = 0;
+
+  for (int i = 0; i < DIM; i += step)
+    for (int j = 0; j < DIM; j += step) {
+      unsigned faites;
+
+      suite_pixel (&c, i, j, &faites);
+      iter += faites;
+      n++;
+    }
+
+  *bytes   = 2 * sizeof (unsigned);
+  *int_ops = 0;
+  *flops   = 10.0 + 8.0 * iter / n;
+}
+
 ///////////////////////////// Version séquentielle simple (seq)
 
 // Renvoie le nombre d'itérations effectuées avant stabilisation, ou 0
@@ -129,9 +327,13 @@ unsigned mandel_compute_seq (unsigned nb_iter)
 {
   for (unsigned it = 1; it <= nb_iter; it++) {
 
+    monitoring_start_tile ();
+
     for (int i = 0; i < DIM; i++)
       for (int j = 0; j < DIM; j++)
-        cur_img (i, j) = iteration_to_color (compute_one_pixel (i, j));
+        cur_iter (i, j) = compute_one_pixel (i, j);
+
+    monitoring_end_tile (0, 0, DIM, DIM, 0);
 
     zoom ();
   }
@@ -144,7 +346,8 @@ unsigned mandel_compute_seq (unsigned nb_iter)
 #ifdef ENABLE_VECTO
 
 #if VEC_SIZE == 8
-static void compute_multiple_pixels (unsigned *iterations, int i, int j)
+static void compute_multiple_pixels (unsigned *iterations, const cadre_t *c,
+                                     int i, int j)
 {
   __m256 zr, zi, cr, ci, norm; //, iter;
   __m256 deux     = _mm256_set1_ps (2.0);
@@ -159,15 +362,29 @@ static void compute_multiple_pixels (unsigned *iterations, int i, int j)
   cr = _mm256_add_ps (_mm256_set1_ps (j),
                       _mm256_set_ps (7, 6, 5, 4, 3, 2, 1, 0));
 
-  cr = _mm256_fmadd_ps (cr, _mm256_set1_ps (xstep), _mm256_set1_ps (leftX));
+  cr = _mm256_fmadd_ps (cr, _mm256_set1_ps (c->xstep),
+                       _mm256_set1_ps (c->leftX));
+
+  ci = _mm256_set1_ps (c->topY - c->ystep * i);
 
-  ci = _mm256_set1_ps (topY - ystep * i);
+  // Voies dont on sait qu'elles ne s'échapperont pas (cf. interieur) : elles
+  // ne retiennent plus la boucle et reçoivent MAX_ITERATIONS à la fin
+  __m256 ci2  = _mm256_mul_ps (ci, ci);
+  __m256 x0   = _mm256_sub_ps (cr, _mm256_set1_ps (0.25f));
+  __m256 q    = _mm256_fmadd_ps (x0, x0, ci2);
+  __m256 x1   = _mm256_add_ps (cr, _mm256_set1_ps (1.0f));
+  __m256i fin = (__m256i)_mm256_or_ps (
+      _mm256_cmp_ps (_mm256_mul_ps (q, _mm256_add_ps (q, x0)),
+                     _mm256_mul_ps (_mm256_set1_ps (0.25f), ci2), _CMP_LE_OS),
+      _mm256_cmp_ps (_mm256_fmadd_ps (x1, x1, ci2), _mm256_set1_ps (0.0625f),
+                     _CMP_LE_OS));
+  __m256 sr = zr, si = zi;
 
   for (int i = 0; i < MAX_ITERATIONS; i++) {
     __m256 rc    = _mm256_mul_ps (zr, zr);
     norm         = _mm256_fmadd_ps (zi, zi, rc);
     __m256i mask = (__m256i)_mm256_cmp_ps (norm, max_norm, _CMP_LE_OS);
-    if (_mm256_testz_si256 (mask, vrai))
+    if (_mm256_testz_si256 (_mm256_andnot_si256 (fin, mask), vrai))
       break;
     iter = _mm256_add_epi32 (iter, _mm256_and_si256 (mask, un));
 
@@ -175,14 +392,26 @@ static void compute_multiple_pixels (unsigned *iterations, int i, int j)
     __m256 y = _mm256_fmadd_ps (deux, _mm256_mul_ps (zr, zi), ci);
     zr       = x;
     zi       = y;
+
+    // Détection de cycle à la Brent (cf. compute_one_pixel_cadre)
+    __m256 cycle = _mm256_and_ps (_mm256_cmp_ps (zr, sr, _CMP_EQ_OQ),
+                                  _mm256_cmp_ps (zi, si, _CMP_EQ_OQ));
+    fin = _mm256_or_si256 (fin, _mm256_and_si256 ((__m256i)cycle, mask));
+    if (((i + 1) & i) == 0) {
+      sr = zr;
+      si = zi;
+    }
   }
 
+  iter = _mm256_blendv_epi8 (iter, _mm256_set1_epi32 (MAX_ITERATIONS), fin);
+
   _mm256_store_si256 ((__m256i *)iterations, iter);
 }
 
 #elif VEC_SIZE == 4
 
-static void compute_multiple_pixels (unsigned *iterations, int i, int j)
+static void compute_multiple_pixels (unsigned *iterations, const cadre_t *c,
+                                     int i, int j)
 {
   __m128 zr, zi, cr, ci, norm, iter;
   __m128 deux     = _mm_set1_ps (2.0);
@@ -191,14 +420,28 @@ static void compute_multiple_pixels (unsigned *iterations, int i, int j)
   __m128 max_norm = _mm_set1_ps (4.0);
 
   zr = zi = norm = iter = _mm_set1_ps (0);
-  cr = _mm_set_ps (leftX + xstep * (j + 3), leftX + xstep * (j + 2),
-                   leftX + xstep * (j + 1), leftX + xstep * (j + 0));
-  ci = _mm_set1_ps (topY - ystep * i);
+  cr = _mm_set_ps (c->leftX + c->xstep * (j + 3),
+                   c->leftX + c->xstep * (j + 2),
+                   c->leftX + c->xstep * (j + 1),
+                   c->leftX + c->xstep * (j + 0));
+  ci = _mm_set1_ps (c->topY - c->ystep * i);
+
+  // Cardioïde, bourgeon et cycles : cf. la version AVX
+  __m128 ci2 = _mm_mul_ps (ci, ci);
+  __m128 x0  = _mm_sub_ps (cr, _mm_set1_ps (0.25f));
+  __m128 q   = _mm_fmadd_ps (x0, x0, ci2);
+  __m128 x1  = _mm_add_ps (cr, _mm_set1_ps (1.0f));
+  __m128 fin = _mm_or_ps (
+      _mm_cmp_ps (_mm_mul_ps (q, _mm_add_ps (q, x0)),
+                  _mm_mul_ps (_mm_set1_ps (0.25f), ci2), _CMP_LE_OS),
+      _mm_cmp_ps (_mm_fmadd_ps (x1, x1, ci2), _mm_set1_ps (0.0625f),
+                  _CMP_LE_OS));
+  __m128 sr = zr, si = zi;
 
   for (int i = 0; i < MAX_ITERATIONS; i++) {
     norm        = _mm_fmadd_ps (zr, zr, _mm_mul_ps (zi, zi));
     __m128 mask = _mm_cmp_ps (norm, max_norm, _CMP_LE_OS);
-    if (_mm_testz_ps (mask, vrai))
+    if (_mm_testz_ps (_mm_andnot_ps (fin, mask), vrai))
       break;
     iter = _mm_add_ps (iter, _mm_and_ps (mask, un));
 
@@ -206,8 +449,18 @@ static void compute_multiple_pixels (unsigned *iterations, int i, int j)
     __m128 y = _mm_fmadd_ps (deux, _mm_mul_ps (zr, zi), ci);
     zr       = x;
     zi       = y;
+
+    __m128 cycle = _mm_and_ps (_mm_cmp_ps (zr, sr, _CMP_EQ_OQ),
+                               _mm_cmp_ps (zi, si, _CMP_EQ_OQ));
+    fin = _mm_or_ps (fin, _mm_and_ps (cycle, mask));
+    if (((i + 1) & i) == 0) {
+      sr = zr;
+      si = zi;
+    }
   }
 
+  iter = _mm_blendv_ps (iter, _mm_set1_ps (MAX_ITERATIONS), fin);
+
   __m128i res = _mm_cvttps_epi32 (iter);
   _mm_store_si128 ((__m128i *)iterations, res);
 }
@@ -220,23 +473,31 @@ static void compute_multiple_pixels (unsigned *iterations, int i, int j)
 
 #if defined(ENABLE_VECTO) && (VEC_SIZE == 4 || VEC_SIZE == 8)
 
-static void do_computation (int i, int j)
+static void do_computation (const cadre_t *c, int i, int j)
 {
   unsigned iterations[VEC_SIZE];
 
-  compute_multiple_pixels (iterations, i, j);
+  compute_multiple_pixels (iterations, c, i, j);
 
   for (int v = 0; v < VEC_SIZE; v++)
-    cur_img (i, j + v) = iteration_to_color (iterations[v]);
+    cur_iter (i, j + v) = iterations[v];
 }
 
-static void traiter_tuile_vec (int i_d, int j_d, int i_f, int j_f)
+static void traiter_tuile_cadre (const cadre_t *c, int i_d, int j_d, int i_f,
+                                 int j_f)
 {
   PRINT_DEBUG ('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
   for (int i = i_d; i <= i_f; i++)
     for (int j = j_d; j <= j_f; j += VEC_SIZE)
-      do_computation (i, j);
+      do_computation (c, i, j);
+}
+
+static void traiter_tuile_vec (int i_d, int j_d, int i_f, int j_f)
+{
+  cadre_t c = cadre_courant ();
+
+  traiter_tuile_cadre (&c, i_d, j_d, i_f, j_f);
 }
 
 // Renvoie le nombre d'itérations effectuées avant stabilisation, ou 0
@@ -245,7 +506,9 @@ unsigned mandel_compute_vec (unsigned nb_iter)
   for (unsigned it = 1; it <= nb_iter; it++) {
 
     // On traite toute l'image en une seule fois
+    monitoring_start_tile ();
     traiter_tuile_vec (0, 0, DIM - 1, DIM - 1);
+    monitoring_end_tile (0, 0, DIM, DIM, 0);
     zoom ();
   }
 
@@ -256,6 +519,14 @@ unsigned mandel_compute_vec (unsigned nb_iter)
 
 #define traiter_tuile_vec(i_d, j_d, i_f, j_f) traiter_tuile (i_d, j_d, i_f, j_f)
 
+static void traiter_tuile_cadre (const cadre_t *c, int i_d, int j_d, int i_f,
+                                 int j_f)
+{
+  for (int i = i_d; i <= i_f; i++)
+    for (int j = j_d; j <= j_f; j++)
+      cur_iter (i, j) = compute_one_pixel_cadre (c, i, j);
+}
+
 #endif
 
 ///////////////////////////// Version séquentielle tuilée (tiled)
@@ -269,7 +540,7 @@ static void traiter_tuile (int i_d, int j_d, int i_f, int j_f)
   for (int i = i_d; i <= i_f; i++)
     for (int j = j_d; j <= j_f; j++) {
       unsigned n     = compute_one_pixel (i, j);
-      cur_img (i, j) = iteration_to_color (n);
+      cur_iter (i, j) = n;
     }
 }
 
@@ -281,10 +552,13 @@ unsigned mandel_compute_tiled (unsigned nb_iter)
 
     // On itére sur les coordonnées des tuiles
     for (int i = 0; i < GRAIN; i++)
-      for (int j = 0; j < GRAIN; j++)
+      for (int j = 0; j < GRAIN; j++) {
+        monitoring_start_tile ();
         traiter_tuile_vec (i * tranche /* i debut */, j * tranche /* j debut */,
                            (i + 1) * tranche - 1 /* i fin */,
                            (j + 1) * tranche - 1 /* j fin */);
+        monitoring_end_tile (j * tranche, i * tranche, tranche, tranche, 0);
+      }
 
     zoom ();
   }
@@ -292,70 +566,142 @@ unsigned mandel_compute_tiled (unsigned nb_iter)
   return 0;
 }
 
-///////////////////////////// Version thread bloc
+///////////////////////////// Pool de threads des versions thread*
 
 static unsigned nb_threads = 2;
 static unsigned iterations = 1;
 
-static pthread_barrier_t barrier;
+static barrier_t barrier;
 
-static void *thread_starter_bloc (void *arg)
+// Les threads du pool sont créés une fois pour toutes par the_init et
+// attendent sur pool_start entre deux appels à the_compute
+static barrier_t pool_start;
+static pthread_t *pool_pid        = NULL;
+static void *(*pool_job) (void *) = NULL;
+
+static void *pool_worker (void *arg)
 {
-  unsigned me    = (unsigned)(intptr_t)arg;
-  unsigned slice = DIM / nb_threads;
-  unsigned i_d   = me * slice;
-  unsigned i_f   = ((me == nb_threads - 1) ? DIM - 1 : (me + 1) * slice - 1);
+  unsigned me = (unsigned)(intptr_t)arg;
 
-  PRINT_DEBUG ('t', "Thread %d/%d started, computing slice [%4u-%4u]\n", me,
-               nb_threads, i_d, i_f);
-  for (unsigned it = 1; it <= iterations; it++) {
-    traiter_tuile_vec (i_d, 0, i_f, DIM - 1);
-#ifdef ENABLE_MONITORING
-    monitoring_add_tile (0, i_d, DIM, i_f - i_d + 1, me);
-#endif
+  pin_current_thread (me);
+  perf_register_thread (0);
 
-#ifdef __APPLE__
-    pthread_barrier_single (&barrier, zoom);
-#else
-    pthread_barrier_wait (&barrier);
-    if (me == 0)
-      zoom ();
-    pthread_barrier_wait (&barrier);
-#endif
+  for (;;) {
+    barrier_wait (&pool_start, me);
+    if (pool_job == NULL)
+      break;
+    pool_job (arg);
   }
 
   return NULL;
 }
 
-unsigned mandel_compute_thread (unsigned nb_iter)
+static void pool_init (void)
 {
   char *str = getenv ("OMP_NUM_THREADS");
 
+  mandel_init ();
+
   if (str != NULL)
     nb_threads = atoi (str);
   else
     nb_threads = get_nb_cores ();
 
-  iterations = nb_iter;
-
-  pthread_t pid[nb_threads - 1];
-
-  pthread_barrier_init (&barrier, NULL, nb_threads);
+  barrier_init (&barrier, nb_threads);
+  barrier_init (&pool_start, nb_threads);
 
+  pool_pid = malloc ((nb_threads - 1) * sizeof (pthread_t));
   for (int i = 0; i < nb_threads - 1; i++)
-    pthread_create (&pid[i], NULL, thread_starter_bloc,
+    pthread_create (&pool_pid[i], NULL, pool_worker,
                     (void *)(intptr_t) (i + 1));
+}
+
+// Chaque job se termine par une barrière entre tous les threads : lorsque le
+// thread 0 en revient, les autres ont fini et retournent sur pool_start
+//
+// Le thread principal joue le rôle du thread 0. Il n'est fixé que le temps
+// du job : les threads qu'il crée ensuite (équipes OpenMP) ne doivent pas
+// hériter d'un placement réduit à une seule unité de calcul.
+static void pool_run (void *(*job) (void *))
+{
+  pin_current_thread (0);
+
+  pool_job = job;
+  barrier_wait (&pool_start, 0);
+  job (0);
+
+  unpin_current_thread ();
+}
 
-  thread_starter_bloc (0);
+static void pool_finalize (void)
+{
+  pool_job = NULL;
+  barrier_wait (&pool_start, 0);
 
   for (int i = 0; i < nb_threads - 1; i++)
-    pthread_join (pid[i], NULL);
+    pthread_join (pool_pid[i], NULL);
+
+  free (pool_pid);
+  pool_pid = NULL;
+
+  barrier_destroy (&pool_start);
+  barrier_destroy (&barrier);
+}
+
+///////////////////////////// Version thread bloc
+
+void mandel_init_thread ()
+{
+  pool_init ();
+}
+
+void mandel_finalize_thread ()
+{
+  pool_finalize ();
+}
+
+static void *thread_starter_bloc (void *arg)
+{
+  unsigned me    = (unsigned)(intptr_t)arg;
+  unsigned slice = DIM / nb_threads;
+  unsigned i_d   = me * slice;
+  unsigned i_f   = ((me == nb_threads - 1) ? DIM - 1 : (me + 1) * slice - 1);
+
+  PRINT_DEBUG ('t', "Thread %d/%d started, computing slice [%4u-%4u]\n", me,
+               nb_threads, i_d, i_f);
+
+  for (unsigned it = 1; it <= iterations; it++) {
+    monitoring_start_tile ();
+    traiter_tuile_vec (i_d, 0, i_f, DIM - 1);
+    monitoring_end_tile (0, i_d, DIM, i_f - i_d + 1, me);
+
+    barrier_single (&barrier, me, zoom);
+  }
+
+  return NULL;
+}
+
+unsigned mandel_compute_thread (unsigned nb_iter)
+{
+  iterations = nb_iter;
+
+  pool_run (thread_starter_bloc);
 
   return 0;
 }
 
 ///////////////////////////// Version thread cyclic
 
+void mandel_init_thread_cyclic ()
+{
+  pool_init ();
+}
+
+void mandel_finalize_thread_cyclic ()
+{
+  pool_finalize ();
+}
+
 static void *thread_starter_cyclic (void *arg)
 {
   unsigned me = (unsigned)(intptr_t)arg;
@@ -365,20 +711,12 @@ static void *thread_starter_cyclic (void *arg)
   for (unsigned it = 1; it <= iterations; it++) {
 
     for (unsigned line = me; line < DIM; line += nb_threads) {
+      monitoring_start_tile ();
       traiter_tuile_vec (line, 0, line, DIM - 1);
-#ifdef ENABLE_MONITORING
-      monitoring_add_tile (0, line, DIM, 1, me);
-#endif
+      monitoring_end_tile (0, line, DIM, 1, me);
     }
 
-#ifdef __APPLE__
-    pthread_barrier_single (&barrier, zoom);
-#else
-    pthread_barrier_wait (&barrier);
-    if (me == 0)
-      zoom ();
-    pthread_barrier_wait (&barrier);
-#endif
+    barrier_single (&barrier, me, zoom);
   }
 
   return NULL;
@@ -386,33 +724,25 @@ static void *thread_starter_cyclic (void *arg)
 
 unsigned mandel_compute_thread_cyclic (unsigned nb_iter)
 {
-  char *str = getenv ("OMP_NUM_THREADS");
-
-  if (str != NULL)
-    nb_threads = atoi (str);
-  else
-    nb_threads = get_nb_cores ();
-
   iterations = nb_iter;
 
-  pthread_t pid[nb_threads - 1];
-
-  pthread_barrier_init (&barrier, NULL, nb_threads);
-
-  for (int i = 0; i < nb_threads - 1; i++)
-    pthread_create (&pid[i], NULL, thread_starter_cyclic,
-                    (void *)(intptr_t) (i + 1));
-
-  thread_starter_cyclic (0);
-
-  for (int i = 0; i < nb_threads - 1; i++)
-    pthread_join (pid[i], NULL);
+  pool_run (thread_starter_cyclic);
 
   return 0;
 }
 
 ///////////////////////////// Version thread dynamique
 
+void mandel_init_thread_dyn ()
+{
+  pool_init ();
+}
+
+void mandel_finalize_thread_dyn ()
+{
+  pool_finalize ();
+}
+
 static pthread_distrib_t distrib;
 
 static void *thread_starter_dyn (void *arg)
@@ -422,51 +752,52 @@ static void *thread_starter_dyn (void *arg)
   PRINT_DEBUG ('t', "Thread %d/%d started\n", me, nb_threads);
 
   for (unsigned it = 1; it <= iterations; it++) {
-    for (;;) {
-      int line = pthread_distrib_get (&distrib);
-      if (line == -1)
-        break;
-      PRINT_DEBUG ('t', "Thread %d got slice [%d]\n", me, line);
-      traiter_tuile_vec (line /* i debut */, 0 /* j debut */, line /* i fin */,
-                         DIM - 1 /* j fin */);
-#ifdef ENABLE_MONITORING
-      monitoring_add_tile (0, line, DIM, 1, me);
-#endif
+    unsigned line, n;
+
+    while ((n = pthread_distrib_get_chunk (&distrib, &line)) != 0) {
+      PRINT_DEBUG ('t', "Thread %d got lines [%d..%d]\n", me, line,
+                   line + n - 1);
+      monitoring_start_tile ();
+      traiter_tuile_vec (line /* i debut */, 0 /* j debut */,
+                         line + n - 1 /* i fin */, DIM - 1 /* j fin */);
+      monitoring_end_tile (0, line, DIM, n, me);
     }
   }
 
+  // Les autres threads peuvent encore être dans la fin de phase du
+  // distributeur : personne ne repart avant que tous en soient sortis,
+  // the_compute suivant le réinitialise
+  barrier_wait (&barrier, me);
+
   return NULL;
 }
 
 unsigned mandel_compute_thread_dyn (unsigned nb_iter)
 {
-  char *str = getenv ("OMP_NUM_THREADS");
-
-  if (str != NULL)
-    nb_threads = atoi (str);
-  else
-    nb_threads = get_nb_cores ();
-
   iterations = nb_iter;
 
-  pthread_t pid[nb_threads - 1];
-
   pthread_distrib_init (&distrib, nb_threads, DIM, zoom);
+  // Des paquets de lignes de plus en plus petits : peu d'accès au compteur
+  // partagé en début de phase, un bon équilibrage en fin de phase
+  pthread_distrib_set_chunk (&distrib, PTHREAD_DISTRIB_GUIDED, 1);
 
-  for (int i = 0; i < nb_threads - 1; i++)
-    pthread_create (&pid[i], NULL, thread_starter_dyn,
-                    (void *)(intptr_t) (i + 1));
-
-  thread_starter_dyn (0);
-
-  for (int i = 0; i < nb_threads - 1; i++)
-    pthread_join (pid[i], NULL);
+  pool_run (thread_starter_dyn);
 
   return 0;
 }
 
 ///////////////////////////// Version thread dynamique avec tuiles rectangles
 
+void mandel_init_thread_dyn_tiled ()
+{
+  pool_init ();
+}
+
+void mandel_finalize_thread_dyn_tiled ()
+{
+  pool_finalize ();
+}
+
 static void *thread_starter_dyn_tiled (void *arg)
 {
   unsigned me = (unsigned)(intptr_t)arg;
@@ -481,43 +812,29 @@ static void *thread_starter_dyn_tiled (void *arg)
       unsigned i = slice / GRAIN;
       unsigned j = slice % GRAIN;
       PRINT_DEBUG ('t', "Thread %d got slice [%d, %d]\n", me, i, j);
+      monitoring_start_tile ();
       traiter_tuile_vec (i * tranche /* i debut */, j * tranche /* j debut */,
                          (i + 1) * tranche - 1 /* i fin */,
                          (j + 1) * tranche - 1 /* j fin */);
-#ifdef ENABLE_MONITORING
-      monitoring_add_tile (j * tranche, i * tranche, tranche, tranche, me);
-#endif
+      monitoring_end_tile (j * tranche, i * tranche, tranche, tranche, me);
     }
   }
 
+  // Voir thread_starter_dyn
+  barrier_wait (&barrier, me);
+
   return NULL;
 }
 
 unsigned mandel_compute_thread_dyn_tiled (unsigned nb_iter)
 {
-  char *str = getenv ("OMP_NUM_THREADS");
-
-  if (str != NULL)
-    nb_threads = atoi (str);
-  else
-    nb_threads = get_nb_cores ();
-
   tranche = DIM / GRAIN;
 
   iterations = nb_iter;
 
-  pthread_t pid[nb_threads - 1];
-
   pthread_distrib_init (&distrib, nb_threads, GRAIN * GRAIN, zoom);
 
-  for (int i = 0; i < nb_threads - 1; i++)
-    pthread_create (&pid[i], NULL, thread_starter_dyn_tiled,
-                    (void *)(intptr_t) (i + 1));
-
-  thread_starter_dyn_tiled (0);
-
-  for (int i = 0; i < nb_threads - 1; i++)
-    pthread_join (pid[i], NULL);
+  pool_run (thread_starter_dyn_tiled);
 
   return 0;
 }
@@ -534,13 +851,12 @@ unsigned mandel_compute_omp (unsigned nb_iter)
 #pragma omp parallel for collapse(2) schedule(runtime)
     for (int i = 0; i < GRAIN; i++)
       for (int j = 0; j < GRAIN; j++) {
+        monitoring_start_tile ();
         traiter_tuile_vec (i * tranche /* i debut */, j * tranche /* j debut */,
                            (i + 1) * tranche - 1 /* i fin */,
                            (j + 1) * tranche - 1 /* j fin */);
-#ifdef ENABLE_MONITORING
-        monitoring_add_tile (j * tranche, i * tranche, tranche, tranche,
+        monitoring_end_tile (j * tranche, i * tranche, tranche, tranche,
                              omp_get_thread_num ());
-#endif
       }
 
     zoom ();
@@ -549,54 +865,240 @@ unsigned mandel_compute_omp (unsigned nb_iter)
   return 0;
 }
 
-///////////////////////////// Version utilisant un ordonnanceur maison (sched)
+///////////////////////////// Versions vectorisées avec recharge des voies
+///////////////////////////// (refill, omp_refill)
+
+#if defined(ENABLE_VECTO) && VEC_SIZE == 8
+
+// Les pixels de la tuile forment une file : dès qu'une voie a terminé (le
+// point s'échappe ou atteint MAX_ITERATIONS), son résultat est écrit dans
+// l'image et elle repart avec le pixel suivant. Près du bord de l'ensemble,
+// les voies ne restent plus inactives à attendre le pixel le plus lent.
+// Chaque voie effectue exactement les mêmes opérations que dans
+// compute_multiple_pixels, les images obtenues sont donc identiques.
+// Retire de la file le prochain pixel à calculer, et renvoie -1 si elle est
+// vide. Les pixels de la cardioïde et du bourgeon sont coloriés au passage.
+static inline int pixel_suivant (const cadre_t *c, int i_d, int j_d, int w,
+                                 int total, int *next, float *cr, float *ci)
+{
+  while (*next < total) {
+    int p = (*next)++;
+    int i = i_d + p / w, j = j_d + p % w;
 
-unsigned P;
+    *cr = fmaf ((float)j, c->xstep, c->leftX);
+    *ci = c->topY - c->ystep * i;
 
-void mandel_init_sched ()
-{
-  xstep = (rightX - leftX) / DIM;
-  ystep = (topY - bottomY) / DIM;
+    if (!interieur (*cr, *ci))
+      return p;
 
-  P = scheduler_init (-1);
-}
+    cur_iter (i, j) = MAX_ITERATIONS;
+  }
 
-void mandel_finalize_sched ()
-{
-  scheduler_finalize ();
+  return -1;
 }
 
-static inline void *pack (int i, int j)
+static void traiter_tuile_refill (const cadre_t *c, int i_d, int j_d, int i_f,
+                                  int j_f)
 {
-  uint64_t x = (uint64_t)i << 32 | j;
-  return (void *)x;
-}
+  const int w     = j_f - j_d + 1;
+  const int total = (i_f - i_d + 1) * w;
+  int next        = 0;
+  unsigned active = 0;
 
-static inline void unpack (void *a, int *i, int *j)
-{
-  *i = (uint64_t)a >> 32;
-  *j = (uint64_t)a & 0xFFFFFFFF;
-}
+  float lane_cr[VEC_SIZE] __attribute__ ((aligned (32)));
+  float lane_ci[VEC_SIZE] __attribute__ ((aligned (32)));
+  unsigned lane_iter[VEC_SIZE] __attribute__ ((aligned (32)));
+  int lane_pixel[VEC_SIZE];
 
-static inline unsigned cpu (int i, int j)
-{
-  return -1; // was: i % P
-}
+  __m256 deux     = _mm256_set1_ps (2.0);
+  __m256 max_norm = _mm256_set1_ps (4.0);
+  __m256i un      = _mm256_set1_epi32 (1);
+  __m256i vrai    = _mm256_set1_epi32 (-1);
+  __m256i max_it  = _mm256_set1_epi32 (MAX_ITERATIONS);
 
-static inline void create_task (task_func_t t, int i, int j)
-{
-  scheduler_create_task (t, pack (i, j), cpu (i, j));
-}
+  PRINT_DEBUG ('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
-//////// First Touch
+  for (int v = 0; v < VEC_SIZE; v++) {
+    lane_pixel[v] =
+        pixel_suivant (c, i_d, j_d, w, total, &next, &lane_cr[v], &lane_ci[v]);
+    if (lane_pixel[v] != -1)
+      active |= 1u << v;
+    else
+      lane_cr[v] = lane_ci[v] = 0;
+  }
 
-static void zero_seq (int i_d, int j_d, int i_f, int j_f)
-{
+  __m256 cr    = _mm256_load_ps (lane_cr);
+  __m256 ci    = _mm256_load_ps (lane_ci);
+  __m256 zr    = _mm256_setzero_ps ();
+  __m256 zi    = _mm256_setzero_ps ();
+  __m256 sr    = zr, si = zi;
+  __m256i iter = _mm256_setzero_si256 ();
 
-  for (int i = i_d; i <= i_f; i++)
-    for (int j = j_d; j <= j_f; j++)
-      cur_img (i, j) = 0;
-}
+  while (active) {
+    __m256 rc    = _mm256_mul_ps (zr, zr);
+    __m256 norm  = _mm256_fmadd_ps (zi, zi, rc);
+    __m256i mask = (__m256i)_mm256_cmp_ps (norm, max_norm, _CMP_LE_OS);
+
+    iter = _mm256_add_epi32 (iter, _mm256_and_si256 (mask, un));
+
+    __m256 x = _mm256_add_ps (rc, _mm256_fnmadd_ps (zi, zi, cr));
+    __m256 y = _mm256_fmadd_ps (deux, _mm256_mul_ps (zr, zi), ci);
+    zr       = x;
+    zi       = y;
+
+    // Détection de cycle à la Brent (cf. compute_one_pixel_cadre) : chaque
+    // voie mémorise Z lorsque son propre nombre d'itérations est une
+    // puissance de 2
+    __m256i cycle = _mm256_and_si256 (
+        mask, (__m256i)_mm256_and_ps (_mm256_cmp_ps (zr, sr, _CMP_EQ_OQ),
+                                      _mm256_cmp_ps (zi, si, _CMP_EQ_OQ)));
+    __m256 p2 = (__m256)_mm256_cmpeq_epi32 (
+        _mm256_and_si256 (iter, _mm256_sub_epi32 (iter, un)),
+        _mm256_setzero_si256 ());
+    sr = _mm256_blendv_ps (sr, zr, p2);
+    si = _mm256_blendv_ps (si, zi, p2);
+
+    // Voies terminées : échappées, arrivées à MAX_ITERATIONS ou cycliques
+    iter          = _mm256_blendv_epi8 (iter, max_it, cycle);
+    __m256i fini  = _mm256_or_si256 (_mm256_andnot_si256 (mask, vrai),
+                                    _mm256_cmpeq_epi32 (iter, max_it));
+    unsigned done = _mm256_movemask_ps ((__m256)fini) & active;
+
+    if (!done)
+      continue;
+
+    _mm256_store_si256 ((__m256i *)lane_iter, iter);
+
+    for (unsigned d = done; d; d &= d - 1) {
+      int v = __builtin_ctz (d);
+      int p = lane_pixel[v];
+
+      cur_iter (i_d + p / w, j_d + p % w) = lane_iter[v];
+
+      lane_pixel[v] =
+          pixel_suivant (c, i_d, j_d, w, total, &next, &lane_cr[v], &lane_ci[v]);
+      if (lane_pixel[v] == -1)
+        active &= ~(1u << v);
+    }
+
+    // Les voies rechargées repartent de z = 0
+    __m256i raz = _mm256_cmpgt_epi32 (
+        _mm256_and_si256 (_mm256_set1_epi32 (done),
+                          _mm256_set_epi32 (128, 64, 32, 16, 8, 4, 2, 1)),
+        _mm256_setzero_si256 ());
+
+    zr   = _mm256_andnot_ps ((__m256)raz, zr);
+    zi   = _mm256_andnot_ps ((__m256)raz, zi);
+    sr   = _mm256_andnot_ps ((__m256)raz, sr);
+    si   = _mm256_andnot_ps ((__m256)raz, si);
+    iter = _mm256_andnot_si256 (raz, iter);
+    cr   = _mm256_load_ps (lane_cr);
+    ci   = _mm256_load_ps (lane_ci);
+  }
+}
+
+#else
+
+#define traiter_tuile_refill traiter_tuile_cadre
+
+#endif
+
+unsigned mandel_compute_refill (unsigned nb_iter)
+{
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    cadre_t c = cadre_courant ();
+
+    monitoring_start_tile ();
+    traiter_tuile_refill (&c, 0, 0, DIM - 1, DIM - 1);
+    monitoring_end_tile (0, 0, DIM, DIM, 0);
+    zoom ();
+  }
+
+  return 0;
+}
+
+unsigned mandel_compute_omp_refill (unsigned nb_iter)
+{
+  tranche = DIM / GRAIN;
+
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    cadre_t c = cadre_courant ();
+
+#pragma omp parallel for collapse(2) schedule(runtime)
+    for (int i = 0; i < GRAIN; i++)
+      for (int j = 0; j < GRAIN; j++) {
+        monitoring_start_tile ();
+        traiter_tuile_refill (&c, i * tranche /* i debut */,
+                              j * tranche /* j debut */,
+                              (i + 1) * tranche - 1 /* i fin */,
+                              (j + 1) * tranche - 1 /* j fin */);
+        monitoring_end_tile (j * tranche, i * tranche, tranche, tranche,
+                             omp_get_thread_num ());
+      }
+
+    zoom ();
+  }
+
+  return 0;
+}
+
+///////////////////////////// Version utilisant un ordonnanceur maison (sched)
+
+unsigned P;
+
+void mandel_init_sched ()
+{
+  mandel_init ();
+
+  P = scheduler_init (-1);
+}
+
+void mandel_finalize_sched ()
+{
+  scheduler_finalize ();
+}
+
+static inline void *pack (int i, int j)
+{
+  uint64_t x = (uint64_t)i << 32 | j;
+  return (void *)x;
+}
+
+static inline void unpack (void *a, int *i, int *j)
+{
+  *i = (uint64_t)a >> 32;
+  *j = (uint64_t)a & 0xFFFFFFFF;
+}
+
+// Chaque tuile reste sur le même worker d'une itération à l'autre, et sur
+// celui qui a touché ses pages en premier (mandel_ft_sched)
+static inline unsigned cpu (int i, int j)
+{
+  return scheduler_place (i, j, GRAIN, GRAIN);
+}
+
+// Une tâche par tuile, soumises en une fois
+static void create_tasks (task_func_t t)
+{
+  void **params = malloc (GRAIN * GRAIN * sizeof (void *));
+
+  for (int i = 0; i < GRAIN; i++)
+    for (int j = 0; j < GRAIN; j++)
+      params[i * GRAIN + j] = pack (i, j);
+
+  scheduler_create_tasks (t, params, GRAIN * GRAIN);
+  free (params);
+}
+
+//////// First Touch
+
+static void zero_seq (int i_d, int j_d, int i_f, int j_f)
+{
+
+  for (int i = i_d; i <= i_f; i++)
+    for (int j = j_d; j <= j_f; j++)
+      cur_iter (i, j) = 0;
+}
 
 static void first_touch_task (void *p, unsigned proc)
 {
@@ -614,9 +1116,7 @@ void mandel_ft_sched (void)
 {
   tranche = DIM / GRAIN;
 
-  for (int i = 0; i < GRAIN; i++)
-    for (int j = 0; j < GRAIN; j++)
-      create_task (first_touch_task, i, j);
+  create_tasks (first_touch_task);
 
   scheduler_task_wait ();
 }
@@ -631,12 +1131,11 @@ static void compute_task (void *p, unsigned proc)
 
   // PRINT_DEBUG ('s', "Compute Task is running on tile (%d, %d) over cpu
   // #%d\n", i, j, proc);
+  monitoring_start_tile ();
   traiter_tuile_vec (i * tranche, j * tranche, (i + 1) * tranche - 1,
                      (j + 1) * tranche - 1);
 
-#ifdef ENABLE_MONITORING
-  monitoring_add_tile (j * tranche, i * tranche, tranche, tranche, proc);
-#endif
+  monitoring_end_tile (j * tranche, i * tranche, tranche, tranche, proc);
 }
 
 unsigned mandel_compute_sched (unsigned nb_iter)
@@ -645,10 +1144,347 @@ unsigned mandel_compute_sched (unsigned nb_iter)
 
   for (unsigned it = 1; it <= nb_iter; it++) {
 
+    create_tasks (compute_task);
+
+    scheduler_task_wait ();
+
+    zoom ();
+  }
+
+  return 0;
+}
+
+///////////////////////////// Version pipelinée sur l'ordonnanceur (sched_pipe)
+
+// Les images successives ne sont plus séparées par une attente globale :
+// la tuile (i, j) de l'image k+1 ne dépend que de la tuile (i, j) de
+// l'image k, qui écrit les mêmes pixels. Chaque image garde son cadrage.
+
+typedef struct
+{
+  const cadre_t *cadre;
+  int i, j;
+} pipe_param_t;
+
+void mandel_init_sched_pipe ()
+{
+  mandel_init_sched ();
+}
+
+void mandel_finalize_sched_pipe ()
+{
+  mandel_finalize_sched ();
+}
+
+void mandel_ft_sched_pipe (void)
+{
+  mandel_ft_sched ();
+}
+
+static void pipe_task (void *p, unsigned proc)
+{
+  pipe_param_t *t = p;
+
+  monitoring_start_tile ();
+  traiter_tuile_cadre (t->cadre, t->i * tranche, t->j * tranche,
+                       (t->i + 1) * tranche - 1, (t->j + 1) * tranche - 1);
+  monitoring_end_tile (t->j * tranche, t->i * tranche, tranche, tranche, proc);
+}
+
+unsigned mandel_compute_sched_pipe (unsigned nb_iter)
+{
+  task_group_t group = scheduler_group_create ();
+  cadre_t *cadres    = malloc (nb_iter * sizeof (cadre_t));
+  task_t *last       = calloc (GRAIN * GRAIN, sizeof (task_t));
+  pipe_param_t *params =
+      malloc (nb_iter * GRAIN * GRAIN * sizeof (pipe_param_t));
+
+  tranche = DIM / GRAIN;
+
+  for (unsigned it = 0; it < nb_iter; it++) {
+    cadres[it] = cadre_courant ();
+
+    for (int i = 0; i < GRAIN; i++)
+      for (int j = 0; j < GRAIN; j++) {
+        pipe_param_t *p = &params[(it * GRAIN + i) * GRAIN + j];
+
+        p->cadre = &cadres[it];
+        p->i     = i;
+        p->j     = j;
+        last[i * GRAIN + j] = scheduler_submit (pipe_task, p, cpu (i, j), group,
+                                                after (last[i * GRAIN + j]));
+      }
+
+    zoom ();
+  }
+
+  scheduler_group_destroy (group);
+
+  free (last);
+  free (params);
+  free (cadres);
+
+  return 0;
+}
+
+///////////////////////////// Boucle parallèle adaptative (sched_for)
+
+// Le grain n'est plus fixé par -g : les rectangles sont coupés tant que
+// des workers manquent de travail, jusqu'à des blocs de PFOR_MIN pixels
+#define PFOR_MIN 16
+
+void mandel_init_sched_for ()
+{
+  mandel_init_sched ();
+}
+
+void mandel_finalize_sched_for ()
+{
+  mandel_finalize_sched ();
+}
+
+void mandel_ft_sched_for (void)
+{
+  mandel_ft_sched ();
+}
+
+static void pfor_body (range_2d_t r, void *arg, unsigned who)
+{
+  monitoring_start_tile ();
+  traiter_tuile_vec (r.y, r.x, r.y + r.h - 1, r.x + r.w - 1);
+  monitoring_end_tile (r.x, r.y, r.w, r.h, who);
+}
+
+unsigned mandel_compute_sched_for (unsigned nb_iter)
+{
+  range_2d_t dom = {0, 0, DIM, DIM};
+
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    scheduler_parallel_for_2d (dom, PFOR_MIN, pfor_body, NULL);
+    zoom ();
+  }
+
+  return 0;
+}
+
+///////////////////////////// Subdivision de Mariani-Silver (ms, omp_ms,
+///////////////////////////// sched_ms)
+
+// On calcule d'abord le bord d'un rectangle. S'il est uniforme (même nombre
+// d'itérations partout), l'intérieur est rempli sans calcul ; sinon, on
+// calcule une ligne et une colonne médianes et on recommence sur les quatre
+// sous-rectangles. Ceux-ci partagent leurs bords et n'écrivent que dans leur
+// intérieur : ils peuvent être traités en parallèle.
+//
+// C'est une approximation : un détail de l'ensemble entièrement contenu
+// dans un rectangle au bord uniforme disparaît.
+
+#define MS_MIN 8   // en dessous, l'intérieur est calculé directement
+#define MS_TASK 32 // en dessous, pas de nouvelle tâche
+
+enum
+{
+  MS_SEQ,
+  MS_OMP,
+  MS_SCHED
+};
+
+static cadre_t ms_cadre;
+
+static inline void ms_pixel (const cadre_t *c, int i, int j)
+{
+  cur_iter (i, j) = compute_one_pixel_cadre (c, i, j);
+}
+
+// Même calcul que seq pour tous les pixels : les seules différences avec
+// seq viennent des rectangles remplis
+static void ms_direct (const cadre_t *c, int i_d, int j_d, int i_f, int j_f)
+{
+  for (int i = i_d; i <= i_f; i++)
+    for (int j = j_d; j <= j_f; j++)
+      cur_iter (i, j) = compute_one_pixel_cadre (c, i, j);
+}
+
+// Renvoie 1 si tous les pixels du bord ont le même nombre d'itérations
+static int ms_uniforme (int i_d, int j_d, int i_f, int j_f)
+{
+  unsigned n = cur_iter (i_d, j_d);
+
+  for (int j = j_d; j <= j_f; j++)
+    if (cur_iter (i_d, j) != n || cur_iter (i_f, j) != n)
+      return 0;
+  for (int i = i_d + 1; i < i_f; i++)
+    if (cur_iter (i, j_d) != n || cur_iter (i, j_f) != n)
+      return 0;
+
+  return 1;
+}
+
+static void ms_rect (int i_d, int j_d, int i_f, int j_f, int mode,
+                     unsigned who);
+
+static void ms_task (void *p, unsigned proc)
+{
+  int *r = p;
+
+  ms_rect (r[0], r[1], r[2], r[3], MS_SCHED, proc);
+  free (r);
+}
+
+static void ms_sous_rect (int i_d, int j_d, int i_f, int j_f, int mode,
+                          unsigned who)
+{
+  if (mode == MS_SEQ || i_f - i_d < MS_TASK || j_f - j_d < MS_TASK)
+    ms_rect (i_d, j_d, i_f, j_f, mode, who);
+  else if (mode == MS_OMP) {
+#pragma omp task firstprivate(i_d, j_d, i_f, j_f)
+    ms_rect (i_d, j_d, i_f, j_f, MS_OMP, omp_get_thread_num ());
+  } else {
+    int *r = malloc (4 * sizeof (int));
+
+    r[0] = i_d;
+    r[1] = j_d;
+    r[2] = i_f;
+    r[3] = j_f;
+    // Sur la file du worker courant : les autres viennent la voler
+    scheduler_create_task (ms_task, r, who);
+  }
+}
+
+// Le bord du rectangle est déjà calculé, on s'occupe de l'intérieur
+static void ms_rect (int i_d, int j_d, int i_f, int j_f, int mode,
+                     unsigned who)
+{
+  const cadre_t *c = &ms_cadre;
+  int im, jm;
+
+  if (i_f - i_d < 2 || j_f - j_d < 2)
+    return;
+
+  monitoring_start_tile ();
+
+  if (ms_uniforme (i_d, j_d, i_f, j_f)) {
+    unsigned n = cur_iter (i_d, j_d);
+
+    for (int i = i_d + 1; i < i_f; i++)
+      for (int j = j_d + 1; j < j_f; j++)
+        cur_iter (i, j) = n;
+
+    monitoring_end_tile (j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, who);
+    return;
+  }
+
+  if (i_f - i_d <= MS_MIN || j_f - j_d <= MS_MIN) {
+    ms_direct (c, i_d + 1, j_d + 1, i_f - 1, j_f - 1);
+
+    monitoring_end_tile (j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, who);
+    return;
+  }
+
+  im = (i_d + i_f) / 2;
+  jm = (j_d + j_f) / 2;
+
+  for (int j = j_d + 1; j < j_f; j++)
+    ms_pixel (c, im, j);
+  for (int i = i_d + 1; i < i_f; i++)
+    if (i != im)
+      ms_pixel (c, i, jm);
+
+  monitoring_end_tile (j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, who);
+
+  ms_sous_rect (i_d, j_d, im, jm, mode, who);
+  ms_sous_rect (i_d, jm, im, j_f, mode, who);
+  ms_sous_rect (im, j_d, i_f, jm, mode, who);
+  ms_sous_rect (im, jm, i_f, j_f, mode, who);
+}
+
+static void ms_tuile (int ti, int tj, int mode, unsigned who)
+{
+  const cadre_t *c = &ms_cadre;
+  int i_d = ti * tranche, i_f = (ti + 1) * tranche - 1;
+  int j_d = tj * tranche, j_f = (tj + 1) * tranche - 1;
+
+  for (int j = j_d; j <= j_f; j++) {
+    ms_pixel (c, i_d, j);
+    ms_pixel (c, i_f, j);
+  }
+  for (int i = i_d + 1; i < i_f; i++) {
+    ms_pixel (c, i, j_d);
+    ms_pixel (c, i, j_f);
+  }
+
+  ms_rect (i_d, j_d, i_f, j_f, mode, who);
+}
+
+unsigned mandel_compute_ms (unsigned nb_iter)
+{
+  tranche = DIM / GRAIN;
+
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    ms_cadre = cadre_courant ();
+
+    for (int i = 0; i < GRAIN; i++)
+      for (int j = 0; j < GRAIN; j++)
+        ms_tuile (i, j, MS_SEQ, 0);
+
+    zoom ();
+  }
+
+  return 0;
+}
+
+unsigned mandel_compute_omp_ms (unsigned nb_iter)
+{
+  tranche = DIM / GRAIN;
+
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    ms_cadre = cadre_courant ();
+
+#pragma omp parallel
+#pragma omp single
     for (int i = 0; i < GRAIN; i++)
       for (int j = 0; j < GRAIN; j++)
-        create_task (compute_task, i, j);
+#pragma omp task firstprivate(i, j)
+        ms_tuile (i, j, MS_OMP, omp_get_thread_num ());
+
+    zoom ();
+  }
+
+  return 0;
+}
+
+void mandel_init_sched_ms ()
+{
+  mandel_init_sched ();
+}
+
+void mandel_finalize_sched_ms ()
+{
+  mandel_finalize_sched ();
+}
+
+void mandel_ft_sched_ms (void)
+{
+  mandel_ft_sched ();
+}
+
+static void ms_tuile_task (void *p, unsigned proc)
+{
+  int i, j;
 
+  unpack (p, &i, &j);
+  ms_tuile (i, j, MS_SCHED, proc);
+}
+
+unsigned mandel_compute_sched_ms (unsigned nb_iter)
+{
+  tranche = DIM / GRAIN;
+
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    ms_cadre = cadre_courant ();
+
+    create_tasks (ms_tuile_task);
+    // Attend aussi les sous-rectangles créés en cours de route
     scheduler_task_wait ();
 
     zoom ();
@@ -657,6 +1493,489 @@ unsigned mandel_compute_sched (unsigned nb_iter)
   return 0;
 }
 
+///////////////////////////// Affinage progressif (prog)
+
+// the_compute ne calcule qu'un pixel sur 8 dans chaque direction et en
+// remplit un bloc 8 x 8 ; l'image est ensuite affinée par passes de pas 4,
+// 2 puis 1 (mandel_refine_prog), chaque passe ne calculant que les pixels
+// absents des précédentes. En mode graphique, main appelle the_refine entre
+// deux images avec un budget de temps (--frame-budget) et réaffiche après
+// chaque appel. L'image suivante abandonne l'affinage de la précédente. Sans
+// budget, l'image est affinée jusqu'au bout dans the_compute et vaut celle
+// de seq.
+
+#define PROG_PAS 8   // pas de la première passe
+#define PROG_RANGS 8 // rangées de blocs entre deux lectures de l'heure
+
+static cadre_t prog_cadre;
+static unsigned prog_pas  = 0; // pas de la passe en cours, 0 : image finie
+static unsigned prog_rang = 0; // prochaine rangée de blocs de cette passe
+
+// Calcule les nouveaux pixels de la rangée i pour le pas courant et remplit
+// le bloc pas x pas de chacun
+static void prog_rangee (unsigned pas, int i)
+{
+  // Sur une ligne déjà calculée à la passe précédente, un pixel sur deux
+  // l'a été aussi
+  int nouvelle = i % (2 * pas) != 0 || pas == PROG_PAS;
+  int i_f      = i + pas < DIM ? i + pas : DIM;
+
+  for (int j = nouvelle ? 0 : pas; j < DIM; j += nouvelle ? pas : 2 * pas) {
+    unsigned n = compute_one_pixel_cadre (&prog_cadre, i, j);
+    int j_f    = j + pas < DIM ? j + pas : DIM;
+
+    for (int ii = i; ii < i_f; ii++)
+      for (int jj = j; jj < j_f; jj++)
+        cur_iter (ii, jj) = n;
+  }
+}
+
+// Avance l'affinage tant que le pas reste supérieur ou égal à pas_min, en au
+// plus budget ms (0 : sans limite)
+static void prog_affiner (unsigned pas_min, unsigned budget)
+{
+  uint64_t fin = phases_now () + (uint64_t)budget * 1000000;
+
+  while (prog_pas >= pas_min && prog_pas != 0) {
+    unsigned rangs = DIM / prog_pas + (DIM % prog_pas != 0);
+    unsigned r_f   = prog_rang + PROG_RANGS < rangs ? prog_rang + PROG_RANGS
+                                                    : rangs;
+
+#pragma omp parallel for schedule(dynamic)
+    for (unsigned r = prog_rang; r < r_f; r++) {
+      monitoring_start_tile ();
+      prog_rangee (prog_pas, r * prog_pas);
+      monitoring_end_tile (0, r * prog_pas, DIM, prog_pas,
+                           omp_get_thread_num ());
+    }
+
+    prog_rang = r_f;
+    if (prog_rang == rangs) {
+      prog_pas /= 2;
+      prog_rang = 0;
+    }
+
+    if (budget && phases_now () >= fin)
+      break;
+  }
+}
+
+// Renvoie 0 une fois l'image entièrement calculée
+unsigned mandel_refine_prog (unsigned budget)
+{
+  prog_affiner (1, budget);
+
+  return prog_pas != 0;
+}
+
+unsigned mandel_compute_prog (unsigned nb_iter)
+{
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    prog_cadre = cadre_courant ();
+    prog_pas   = PROG_PAS;
+    prog_rang  = 0;
+
+    // Première passe en entier, la suite en mode graphique viendra de
+    // the_refine
+    prog_affiner (PROG_PAS, 0);
+    if (!frame_budget)
+      prog_affiner (1, 0);
+
+    zoom ();
+  }
+
+  return 0;
+}
+
+///////////////////////////// Zoom profond : double précision (f64, omp_f64)
+///////////////////////////// et perturbation (pert, omp_pert)
+
+// En float, xstep n'est plus représentable au bout de quelques centaines
+// d'images de zoom et l'image dégénère en blocs. Les versions f64 calculent
+// en double (4 pixels par vecteur AVX2) ; les versions pert vont plus loin en
+// ne calculant qu'une orbite de référence en long double, au centre de
+// l'image, puis l'écart de chaque pixel à cette orbite en double.
+
+typedef struct
+{
+  double leftX, topY, xstep, ystep;
+} cadre_f64_t;
+
+static inline cadre_f64_t cadre_f64_courant (void)
+{
+  return (cadre_f64_t){leftX, topY, xstep, ystep};
+}
+
+static inline int interieur_f64 (double cr, double ci)
+{
+  double ci2 = ci * ci;
+  double x   = cr - 0.25;
+  double q   = x * x + ci2;
+
+  return q * (q + x) <= 0.25 * ci2 || (cr + 1.0) * (cr + 1.0) + ci2 <= 0.0625;
+}
+
+static unsigned compute_one_pixel_f64 (const cadre_f64_t *c, int i, int j)
+{
+  double cr = c->leftX + c->xstep * j;
+  double ci = c->topY - c->ystep * i;
+  double zr = 0.0, zi = 0.0;
+  double sr = 0.0, si = 0.0;
+  int iter;
+
+  if (interieur_f64 (cr, ci))
+    return MAX_ITERATIONS;
+
+  for (iter = 0; iter < MAX_ITERATIONS; iter++) {
+    double x2 = zr * zr;
+    double y2 = zi * zi;
+
+    if (x2 + y2 > 4.0)
+      break;
+
+    double twoxy = 2.0 * zr * zi;
+    zr           = x2 - y2 + cr;
+    zi           = twoxy + ci;
+
+    // Cycle (cf. compute_one_pixel_cadre)
+    if (zr == sr && zi == si)
+      return MAX_ITERATIONS;
+    if (((iter + 1) & iter) == 0) {
+      sr = zr;
+      si = zi;
+    }
+  }
+
+  return iter;
+}
+
+#if defined(ENABLE_VECTO) && VEC_SIZE == 8
+
+#define VEC_F64 4
+
+static void compute_multiple_pixels_f64 (unsigned *iterations,
+                                         const cadre_f64_t *c, int i, int j)
+{
+  __m256d deux     = _mm256_set1_pd (2.0);
+  __m256d max_norm = _mm256_set1_pd (4.0);
+  __m256i un       = _mm256_set1_epi64x (1);
+  __m256i vrai     = _mm256_set1_epi64x (-1);
+  __m256i iter     = _mm256_setzero_si256 ();
+  __m256d zr = _mm256_setzero_pd (), zi = zr, sr = zr, si = zr;
+
+  __m256d cr = _mm256_fmadd_pd (
+      _mm256_add_pd (_mm256_set1_pd (j), _mm256_set_pd (3, 2, 1, 0)),
+      _mm256_set1_pd (c->xstep), _mm256_set1_pd (c->leftX));
+  __m256d ci = _mm256_set1_pd (c->topY - c->ystep * i);
+
+  // Cardioïde et bourgeon (cf. interieur)
+  __m256d ci2 = _mm256_mul_pd (ci, ci);
+  __m256d x0  = _mm256_sub_pd (cr, _mm256_set1_pd (0.25));
+  __m256d q   = _mm256_fmadd_pd (x0, x0, ci2);
+  __m256d x1  = _mm256_add_pd (cr, _mm256_set1_pd (1.0));
+  __m256i fin = (__m256i)_mm256_or_pd (
+      _mm256_cmp_pd (_mm256_mul_pd (q, _mm256_add_pd (q, x0)),
+                     _mm256_mul_pd (_mm256_set1_pd (0.25), ci2), _CMP_LE_OS),
+      _mm256_cmp_pd (_mm256_fmadd_pd (x1, x1, ci2), _mm256_set1_pd (0.0625),
+                     _CMP_LE_OS));
+
+  for (int n = 0; n < MAX_ITERATIONS; n++) {
+    __m256d rc   = _mm256_mul_pd (zr, zr);
+    __m256d norm = _mm256_fmadd_pd (zi, zi, rc);
+    __m256i mask = (__m256i)_mm256_cmp_pd (norm, max_norm, _CMP_LE_OS);
+    if (_mm256_testz_si256 (_mm256_andnot_si256 (fin, mask), vrai))
+      break;
+    iter = _mm256_add_epi64 (iter, _mm256_and_si256 (mask, un));
+
+    __m256d x = _mm256_add_pd (rc, _mm256_fnmadd_pd (zi, zi, cr));
+    __m256d y = _mm256_fmadd_pd (deux, _mm256_mul_pd (zr, zi), ci);
+    zr        = x;
+    zi        = y;
+
+    __m256d cycle = _mm256_and_pd (_mm256_cmp_pd (zr, sr, _CMP_EQ_OQ),
+                                   _mm256_cmp_pd (zi, si, _CMP_EQ_OQ));
+    fin = _mm256_or_si256 (fin, _mm256_and_si256 ((__m256i)cycle, mask));
+    if (((n + 1) & n) == 0) {
+      sr = zr;
+      si = zi;
+    }
+  }
+
+  iter = _mm256_blendv_epi8 (iter, _mm256_set1_epi64x (MAX_ITERATIONS), fin);
+
+  for (int v = 0; v < VEC_F64; v++)
+    iterations[v] = ((uint64_t *)&iter)[v];
+}
+
+#endif
+
+static void traiter_tuile_f64 (const cadre_f64_t *c, int i_d, int j_d, int i_f,
+                               int j_f)
+{
+  for (int i = i_d; i <= i_f; i++) {
+    int j = j_d;
+
+#ifdef VEC_F64
+    unsigned iterations[VEC_F64];
+
+    for (; j + VEC_F64 - 1 <= j_f; j += VEC_F64) {
+      compute_multiple_pixels_f64 (iterations, c, i, j);
+      for (int v = 0; v < VEC_F64; v++)
+        cur_iter (i, j + v) = iterations[v];
+    }
+#endif
+    for (; j <= j_f; j++)
+      cur_iter (i, j) = compute_one_pixel_f64 (c, i, j);
+  }
+}
+
+unsigned mandel_compute_f64 (unsigned nb_iter)
+{
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    cadre_f64_t c = cadre_f64_courant ();
+
+    monitoring_start_tile ();
+    traiter_tuile_f64 (&c, 0, 0, DIM - 1, DIM - 1);
+    monitoring_end_tile (0, 0, DIM, DIM, 0);
+    zoom ();
+  }
+
+  return 0;
+}
+
+unsigned mandel_compute_omp_f64 (unsigned nb_iter)
+{
+  tranche = DIM / GRAIN;
+
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    cadre_f64_t c = cadre_f64_courant ();
+
+#pragma omp parallel for collapse(2) schedule(runtime)
+    for (int i = 0; i < GRAIN; i++)
+      for (int j = 0; j < GRAIN; j++) {
+        monitoring_start_tile ();
+        traiter_tuile_f64 (&c, i * tranche /* i debut */,
+                           j * tranche /* j debut */,
+                           (i + 1) * tranche - 1 /* i fin */,
+                           (j + 1) * tranche - 1 /* j fin */);
+        monitoring_end_tile (j * tranche, i * tranche, tranche, tranche,
+                             omp_get_thread_num ());
+      }
+
+    zoom ();
+  }
+
+  return 0;
+}
+
+//////// Perturbation
+
+// Orbite de référence Z_0 .. Z_ref_len du centre de l'image, calculée en
+// long double et rangée en double (|Z| <= 2, la précision relative suffit).
+// Un pixel c = centre + dc suit z_n = Z_m + d_m, avec
+//   d_(m+1) = d_m (2 Z_m + d_m) + dc
+// Lorsque |z_n| < |d_m| (l'écart a perdu sa précision : « glitch ») ou que
+// l'orbite de référence s'est échappée, on repart de son début avec d = z_n
+// (rebasing), n continuant de compter les itérations.
+static double *ref_r = NULL, *ref_i = NULL;
+static int ref_len   = 0;
+
+typedef struct
+{
+  double dx0, dy0, dxs, dys; // écart du coin haut gauche au centre, pas
+} cadre_pert_t;
+
+static cadre_pert_t orbite_reference (void)
+{
+  long double cx = (leftX + rightX) / 2, cy = (topY + bottomY) / 2;
+  long double zr = 0, zi = 0;
+
+  if (ref_r == NULL) {
+    ref_r = malloc ((MAX_ITERATIONS + 1) * sizeof (double));
+    ref_i = malloc ((MAX_ITERATIONS + 1) * sizeof (double));
+    if (ref_r == NULL || ref_i == NULL)
+      exit_with_error ("Cannot allocate reference orbit\n");
+  }
+
+  for (ref_len = 0;; ref_len++) {
+    ref_r[ref_len] = zr;
+    ref_i[ref_len] = zi;
+
+    if (ref_len == MAX_ITERATIONS || zr * zr + zi * zi > 4)
+      break;
+
+    long double x = zr * zr - zi * zi + cx;
+    zi            = 2 * zr * zi + cy;
+    zr            = x;
+  }
+
+  return (cadre_pert_t){leftX - cx, topY - cy, xstep, ystep};
+}
+
+void mandel_finalize_pert ()
+{
+  free (ref_r);
+  free (ref_i);
+  ref_r = ref_i = NULL;
+}
+
+void mandel_finalize_omp_pert ()
+{
+  mandel_finalize_pert ();
+}
+
+static unsigned compute_one_pixel_pert (const cadre_pert_t *p, int i, int j)
+{
+  double dcr = p->dx0 + p->dxs * j;
+  double dci = p->dy0 - p->dys * i;
+  double dr = 0.0, di = 0.0;
+  int m = 0, iter;
+
+  for (iter = 0; iter < MAX_ITERATIONS; iter++) {
+    double zr   = ref_r[m] + dr;
+    double zi   = ref_i[m] + di;
+    double norm = zr * zr + zi * zi;
+
+    if (norm > 4.0)
+      break;
+
+    if (norm < dr * dr + di * di || m == ref_len) {
+      dr = zr;
+      di = zi;
+      m  = 0;
+    }
+
+    double tr = 2.0 * ref_r[m] + dr;
+    double ti = 2.0 * ref_i[m] + di;
+    double x  = dr * tr - di * ti + dcr;
+    di        = dr * ti + di * tr + dci;
+    dr        = x;
+    m++;
+  }
+
+  return iter;
+}
+
+#ifdef VEC_F64
+
+// Même calcul sur 4 pixels : chaque voie a son propre indice dans l'orbite
+// de référence, lue avec gather
+static void compute_multiple_pixels_pert (unsigned *iterations,
+                                          const cadre_pert_t *p, int i, int j)
+{
+  __m256d deux     = _mm256_set1_pd (2.0);
+  __m256d max_norm = _mm256_set1_pd (4.0);
+  __m256i un       = _mm256_set1_epi64x (1);
+  __m256i vrai     = _mm256_set1_epi64x (-1);
+  __m256i len      = _mm256_set1_epi64x (ref_len);
+  __m256i iter     = _mm256_setzero_si256 ();
+  __m256i m        = _mm256_setzero_si256 ();
+  __m256i actif    = vrai;
+  __m256d dr = _mm256_setzero_pd (), di = dr;
+
+  __m256d dcr = _mm256_fmadd_pd (
+      _mm256_add_pd (_mm256_set1_pd (j), _mm256_set_pd (3, 2, 1, 0)),
+      _mm256_set1_pd (p->dxs), _mm256_set1_pd (p->dx0));
+  __m256d dci = _mm256_set1_pd (p->dy0 - p->dys * i);
+
+  for (int n = 0; n < MAX_ITERATIONS; n++) {
+    __m256d Zr   = _mm256_i64gather_pd (ref_r, m, 8);
+    __m256d Zi   = _mm256_i64gather_pd (ref_i, m, 8);
+    __m256d zr   = _mm256_add_pd (Zr, dr);
+    __m256d zi   = _mm256_add_pd (Zi, di);
+    __m256d norm = _mm256_fmadd_pd (zi, zi, _mm256_mul_pd (zr, zr));
+
+    // Une voie échappée ne revient pas, même si l'écart devient NaN
+    actif = _mm256_and_si256 (
+        actif, (__m256i)_mm256_cmp_pd (norm, max_norm, _CMP_LE_OS));
+    if (_mm256_testz_si256 (actif, vrai))
+      break;
+    iter = _mm256_add_epi64 (iter, _mm256_and_si256 (actif, un));
+
+    // Rebasing
+    __m256d reb = _mm256_or_pd (
+        _mm256_cmp_pd (norm, _mm256_fmadd_pd (di, di, _mm256_mul_pd (dr, dr)),
+                       _CMP_LT_OS),
+        (__m256d)_mm256_cmpeq_epi64 (m, len));
+    dr = _mm256_blendv_pd (dr, zr, reb);
+    di = _mm256_blendv_pd (di, zi, reb);
+    Zr = _mm256_andnot_pd (reb, Zr);
+    Zi = _mm256_andnot_pd (reb, Zi);
+    m  = _mm256_andnot_si256 ((__m256i)reb, m);
+
+    __m256d tr = _mm256_fmadd_pd (deux, Zr, dr);
+    __m256d ti = _mm256_fmadd_pd (deux, Zi, di);
+    __m256d x  = _mm256_fmadd_pd (dr, tr, _mm256_fnmadd_pd (di, ti, dcr));
+    di         = _mm256_fmadd_pd (dr, ti, _mm256_fmadd_pd (di, tr, dci));
+    dr         = x;
+    m          = _mm256_add_epi64 (m, un);
+  }
+
+  for (int v = 0; v < VEC_F64; v++)
+    iterations[v] = ((uint64_t *)&iter)[v];
+}
+
+#endif
+
+static void traiter_tuile_pert (const cadre_pert_t *p, int i_d, int j_d,
+                                int i_f, int j_f)
+{
+  for (int i = i_d; i <= i_f; i++) {
+    int j = j_d;
+
+#ifdef VEC_F64
+    unsigned iterations[VEC_F64];
+
+    for (; j + VEC_F64 - 1 <= j_f; j += VEC_F64) {
+      compute_multiple_pixels_pert (iterations, p, i, j);
+      for (int v = 0; v < VEC_F64; v++)
+        cur_iter (i, j + v) = iterations[v];
+    }
+#endif
+    for (; j <= j_f; j++)
+      cur_iter (i, j) = compute_one_pixel_pert (p, i, j);
+  }
+}
+
+unsigned mandel_compute_pert (unsigned nb_iter)
+{
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    cadre_pert_t p = orbite_reference ();
+
+    monitoring_start_tile ();
+    traiter_tuile_pert (&p, 0, 0, DIM - 1, DIM - 1);
+    monitoring_end_tile (0, 0, DIM, DIM, 0);
+    zoom ();
+  }
+
+  return 0;
+}
+
+unsigned mandel_compute_omp_pert (unsigned nb_iter)
+{
+  tranche = DIM / GRAIN;
+
+  for (unsigned it = 1; it <= nb_iter; it++) {
+    cadre_pert_t p = orbite_reference ();
+
+#pragma omp parallel for collapse(2) schedule(runtime)
+    for (int i = 0; i < GRAIN; i++)
+      for (int j = 0; j < GRAIN; j++) {
+        monitoring_start_tile ();
+        traiter_tuile_pert (&p, i * tranche /* i debut */,
+                            j * tranche /* j debut */,
+                            (i + 1) * tranche - 1 /* i fin */,
+                            (j + 1) * tranche - 1 /* j fin */);
+        monitoring_end_tile (j * tranche, i * tranche, tranche, tranche,
+                             omp_get_thread_num ());
+      }
+
+    zoom ();
+  }
+
+  return 0;
+}
+
 //////////////////////////////////////////////////////////////////////////
 ///////////////////////////// Version OpenCL
 
@@ -666,6 +1985,11 @@ void mandel_init_ocl ()
   ystep = (topY - bottomY) / DIM;
 }
 
+// Le noyau OpenCL produit directement les couleurs
+void mandel_refresh_img_ocl ()
+{
+}
+
 unsigned mandel_compute_ocl (unsigned nb_iter)
 {
   size_t global[2] = {SIZE, SIZE};   // global domain size for our calculation
@@ -674,15 +1998,16 @@ unsigned mandel_compute_ocl (unsigned nb_iter)
   unsigned max_iter = MAX_ITERATIONS;
 
   for (unsigned it = 1; it <= nb_iter; it++) {
+    cadre_t c = cadre_courant ();
 
     // Set kernel arguments
     //
     err = 0;
     err |= clSetKernelArg (compute_kernel, 0, sizeof (cl_mem), &cur_buffer);
-    err |= clSetKernelArg (compute_kernel, 1, sizeof (float), &leftX);
-    err |= clSetKernelArg (compute_kernel, 2, sizeof (float), &xstep);
-    err |= clSetKernelArg (compute_kernel, 3, sizeof (float), &topY);
-    err |= clSetKernelArg (compute_kernel, 4, sizeof (float), &ystep);
+    err |= clSetKernelArg (compute_kernel, 1, sizeof (float), &c.leftX);
+    err |= clSetKernelArg (compute_kernel, 2, sizeof (float), &c.xstep);
+    err |= clSetKernelArg (compute_kernel, 3, sizeof (float), &c.topY);
+    err |= clSetKernelArg (compute_kernel, 4, sizeof (float), &c.ystep);
     err |= clSetKernelArg (compute_kernel, 5, sizeof (unsigned), &max_iter);
 
     check (err, "Failed to set kernel arguments");
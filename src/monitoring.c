@@ -131,6 +131,13 @@ void __monitoring_add_tile (int x, int y, int width, int height, int color)
   SDL_FillRect (surface, &dst, colors[color % MAX_COLORS]);
 }
 
+// Les tuiles sont dessinées ici, par le thread principal, à partir des
+// événements enregistrés pendant le calcul
+static void draw_tile (trace_event_t *e)
+{
+  __monitoring_add_tile (e->x, e->y, e->w, e->h, e->who);
+}
+
 void monitoring_end ()
 {
   if (!display)
@@ -138,6 +145,8 @@ void monitoring_end ()
 
   SDL_Rect src, dst;
 
+  trace_replay (draw_tile);
+
   SDL_GL_BindTexture (texture, NULL, NULL);
 
   glTexSubImage2D (GL_TEXTURE_2D, 0, /* mipmap level */
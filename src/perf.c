@@ -0,0 +1,416 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "compute.h"
+#include "debug.h"
+#include "global.h"
+#include "perf.h"
+
+char *perf_param      = NULL;
+unsigned perf_enabled = 0;
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <omp.h>
+
+#define PERF_MAX_EVENTS 16
+#define PERF_MAX_THREADS 1024
+#define CACHE_LINE 64
+
+#define HW_CACHE(c, op, res)                                                   \
+  ((PERF_COUNT_HW_CACHE_##c) | (PERF_COUNT_HW_CACHE_OP_##op << 8) |           \
+   (PERF_COUNT_HW_CACHE_RESULT_##res << 16))
+
+static struct
+{
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+} known_events[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"stalled-cycles-frontend", PERF_TYPE_HARDWARE,
+     PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+    {"stalled-cycles-backend", PERF_TYPE_HARDWARE,
+     PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+    {"L1-dcache-loads", PERF_TYPE_HW_CACHE, HW_CACHE (L1D, READ, ACCESS)},
+    {"L1-dcache-load-misses", PERF_TYPE_HW_CACHE, HW_CACHE (L1D, READ, MISS)},
+    {"LLC-loads", PERF_TYPE_HW_CACHE, HW_CACHE (LL, READ, ACCESS)},
+    {"LLC-load-misses", PERF_TYPE_HW_CACHE, HW_CACHE (LL, READ, MISS)},
+    {"LLC-misses", PERF_TYPE_HW_CACHE, HW_CACHE (LL, READ, MISS)},
+    {"LLC-stores", PERF_TYPE_HW_CACHE, HW_CACHE (LL, WRITE, ACCESS)},
+    {"LLC-store-misses", PERF_TYPE_HW_CACHE, HW_CACHE (LL, WRITE, MISS)},
+    {"dTLB-load-misses", PERF_TYPE_HW_CACHE, HW_CACHE (DTLB, READ, MISS)},
+    {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+};
+
+#define NB_KNOWN (sizeof (known_events) / sizeof (known_events[0]))
+
+typedef struct
+{
+  int fd[PERF_MAX_EVENTS];
+  int transient;
+  pid_t tid;
+  uint64_t count[PERF_MAX_EVENTS];
+} perf_group_t;
+
+static unsigned nb_events = 0;
+static unsigned event[PERF_MAX_EVENTS]; // indices dans known_events
+
+static perf_group_t *groups[PERF_MAX_THREADS];
+static unsigned nb_groups = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int measuring        = 0;
+
+static uint64_t total[PERF_MAX_EVENTS];
+static uint64_t transient_count[PERF_MAX_EVENTS];
+static unsigned long nb_calls = 0, nb_iterations = 0;
+static double compute_time = 0.0; // secondes
+static struct timespec t_start;
+
+static int open_event (unsigned e, int group_fd, int disabled)
+{
+  struct perf_event_attr attr;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.size           = sizeof (attr);
+  attr.type           = known_events[e].type;
+  attr.config         = known_events[e].config;
+  attr.disabled       = disabled;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall (__NR_perf_event_open, &attr, 0 /* thread courant */,
+                  -1 /* n'importe quel cpu */, group_fd, 0);
+}
+
+static void close_group (perf_group_t *g)
+{
+  for (int e = nb_events - 1; e >= 0; e--)
+    if (g->fd[e] >= 0)
+      close (g->fd[e]);
+  free (g);
+}
+
+// Appelée avec le verrou
+static void read_group (perf_group_t *g, uint64_t *acc)
+{
+  uint64_t buf[3 + PERF_MAX_EVENTS];
+
+  ioctl (g->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  if (read (g->fd[0], buf, sizeof (buf)) < (ssize_t) (3 * sizeof (uint64_t)))
+    return;
+
+  // Mise à l'échelle si le groupe n'a pas été compté en permanence
+  // (multiplexage des compteurs)
+  for (unsigned e = 0; e < buf[0] && e < nb_events; e++) {
+    uint64_t v = buf[3 + e];
+    if (buf[2] && buf[2] < buf[1])
+      v = (uint64_t) ((double)v * buf[1] / buf[2]);
+    else if (!buf[2])
+      v = 0;
+    g->count[e] += v;
+    acc[e] += v;
+  }
+}
+
+void perf_register_thread (int transient)
+{
+  perf_group_t *g;
+
+  if (!perf_enabled)
+    return;
+
+  g = calloc (1, sizeof (perf_group_t));
+  if (g == NULL)
+    return;
+
+  g->transient = transient;
+  g->tid       = syscall (__NR_gettid);
+
+  pthread_mutex_lock (&lock);
+
+  for (unsigned e = 0; e < nb_events; e++) {
+    g->fd[e] = open_event (event[e], e ? g->fd[0] : -1, e ? 0 : !measuring);
+    if (g->fd[e] < 0) {
+      PRINT_DEBUG ('p', "Thread %d: cannot open counter %s (%s)\n", g->tid,
+                   known_events[event[e]].name, strerror (errno));
+      for (unsigned k = e; k < nb_events; k++)
+        g->fd[k] = -1;
+      close_group (g);
+      pthread_mutex_unlock (&lock);
+      return;
+    }
+  }
+
+  if (nb_groups < PERF_MAX_THREADS)
+    groups[nb_groups++] = g;
+  else
+    close_group (g);
+
+  pthread_mutex_unlock (&lock);
+
+  PRINT_DEBUG ('p', "Thread %d: %u counters opened\n", g->tid, nb_events);
+}
+
+static void list_events (void)
+{
+  fprintf (stderr, "Available counters:");
+  for (unsigned e = 0; e < NB_KNOWN; e++)
+    fprintf (stderr, " %s", known_events[e].name);
+  fprintf (stderr, "\n");
+}
+
+void perf_init (void)
+{
+  char *list, *name, *saveptr = NULL;
+
+  if (perf_param == NULL)
+    return;
+
+  if (!strcmp (perf_param, "list")) {
+    list_events ();
+    exit (EXIT_SUCCESS);
+  }
+
+  list = strdup (perf_param);
+
+  // Chaque compteur est d'abord essayé seul sur le thread principal : ceux
+  // que la machine ne fournit pas sont écartés
+  for (name = strtok_r (list, ",", &saveptr); name != NULL;
+       name = strtok_r (NULL, ",", &saveptr)) {
+    unsigned e;
+    int fd;
+
+    for (e = 0; e < NB_KNOWN && strcmp (name, known_events[e].name); e++)
+      ;
+
+    if (e == NB_KNOWN) {
+      fprintf (stderr, "Warning: unknown counter %s ignored\n", name);
+      list_events ();
+      continue;
+    }
+    if (nb_events == PERF_MAX_EVENTS) {
+      fprintf (stderr, "Warning: too many counters, %s ignored\n", name);
+      continue;
+    }
+
+    fd = open_event (e, -1, 1);
+    if (fd < 0) {
+      fprintf (stderr, "Warning: counter %s unavailable (%s)\n", name,
+               strerror (errno));
+      if (errno == EACCES || errno == EPERM)
+        fprintf (stderr, "  (see /proc/sys/kernel/perf_event_paranoid)\n");
+      continue;
+    }
+    close (fd);
+
+    event[nb_events++] = e;
+  }
+
+  free (list);
+
+  if (nb_events == 0) {
+    fprintf (stderr, "Warning: no performance counter available, "
+                     "--perf-counters ignored\n");
+    return;
+  }
+
+  perf_enabled = 1;
+
+  // L'équipe OpenMP (dont le thread principal) est enregistrée d'emblée
+#pragma omp parallel
+  perf_register_thread (0);
+
+  if (nb_groups == 0) {
+    fprintf (stderr, "Warning: cannot open counter groups, --perf-counters "
+                     "ignored\n");
+    perf_enabled = 0;
+  }
+}
+
+void perf_start (void)
+{
+  if (!perf_enabled)
+    return;
+
+  pthread_mutex_lock (&lock);
+
+  measuring = 1;
+  for (unsigned g = 0; g < nb_groups; g++) {
+    ioctl (groups[g]->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl (groups[g]->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  pthread_mutex_unlock (&lock);
+
+  clock_gettime (CLOCK_MONOTONIC, &t_start);
+}
+
+static int find_event (const char *name)
+{
+  for (unsigned e = 0; e < nb_events; e++)
+    if (!strcmp (known_events[event[e]].name, name))
+      return e;
+  return -1;
+}
+
+static void print_metrics (FILE *f, const char *prefix, uint64_t *count,
+                           double seconds, unsigned long iterations)
+{
+  int cyc = find_event ("cycles"), ins = find_event ("instructions");
+  int llc = find_event ("LLC-load-misses");
+  double cells = (double)DIM * DIM * iterations;
+
+  if (llc < 0)
+    llc = find_event ("LLC-misses");
+  if (llc < 0)
+    llc = find_event ("cache-misses");
+
+  if (cyc >= 0 && ins >= 0 && count[cyc])
+    fprintf (f, "%sIPC %.2f", prefix, (double)count[ins] / count[cyc]);
+  if (ins >= 0 && cells > 0)
+    fprintf (f, "%sinstructions/cell %.1f", prefix, count[ins] / cells);
+  if (llc >= 0 && cells > 0)
+    fprintf (f, "%s%s/cell %.4f", prefix, known_events[event[llc]].name,
+             count[llc] / cells);
+  if (llc >= 0 && seconds > 0)
+    fprintf (f, "%sbandwidth ~%.2f GB/s", prefix,
+             count[llc] * (double)CACHE_LINE / seconds / 1e9);
+}
+
+void perf_stop (unsigned nb_iter)
+{
+  struct timespec t_end;
+  uint64_t call[PERF_MAX_EVENTS] = {0};
+  double seconds;
+  unsigned g;
+
+  if (!perf_enabled)
+    return;
+
+  clock_gettime (CLOCK_MONOTONIC, &t_end);
+  seconds = (t_end.tv_sec - t_start.tv_sec) +
+            (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+
+  pthread_mutex_lock (&lock);
+
+  for (g = 0; g < nb_groups; g++)
+    read_group (groups[g], call);
+
+  // Les threads créés pendant l'appel ont disparu : leurs compteurs sont
+  // cumulés ensemble puis fermés
+  for (g = 0; g < nb_groups;)
+    if (groups[g]->transient) {
+      for (unsigned e = 0; e < nb_events; e++)
+        transient_count[e] += groups[g]->count[e];
+      close_group (groups[g]);
+      groups[g] = groups[--nb_groups];
+    } else
+      g++;
+
+  measuring = 0;
+
+  pthread_mutex_unlock (&lock);
+
+  for (unsigned e = 0; e < nb_events; e++)
+    total[e] += call[e];
+  compute_time += seconds;
+  nb_iterations += nb_iter;
+  nb_calls++;
+
+  if (debug_enabled ('p')) {
+    fprintf (stderr, "[perf] call %lu (%u iterations):", nb_calls, nb_iter);
+    print_metrics (stderr, " ", call, seconds, nb_iter);
+    fprintf (stderr, "\n");
+  }
+}
+
+void perf_finalize (void)
+{
+  if (!perf_enabled)
+    return;
+
+  printf ("Performance counters for %s/%s, DIM %u, %lu iterations, "
+          "%.3f s of compute:\n",
+          kernel, version, DIM, nb_iterations, compute_time);
+
+  for (unsigned e = 0; e < nb_events; e++)
+    printf ("  %-24s %16llu\n", known_events[event[e]].name,
+            (unsigned long long)total[e]);
+
+  print_metrics (stdout, "\n  ", total, compute_time, nb_iterations);
+  printf ("\n");
+
+  // Répartition entre threads, utile pour repérer un déséquilibre
+  if (nb_groups > 1 || debug_enabled ('p')) {
+    int cyc = find_event ("cycles"), ins = find_event ("instructions");
+
+    for (unsigned g = 0; g < nb_groups; g++) {
+      printf ("  thread %-6d", groups[g]->tid);
+      for (unsigned e = 0; e < nb_events; e++)
+        printf (" %s=%llu", known_events[event[e]].name,
+                (unsigned long long)groups[g]->count[e]);
+      if (cyc >= 0 && ins >= 0 && groups[g]->count[cyc])
+        printf (" IPC=%.2f",
+                (double)groups[g]->count[ins] / groups[g]->count[cyc]);
+      printf ("\n");
+    }
+    if (transient_count[0])
+      printf ("  short-lived threads: %s=%llu\n", known_events[event[0]].name,
+              (unsigned long long)transient_count[0]);
+  }
+
+  for (unsigned g = 0; g < nb_groups; g++)
+    close_group (groups[g]);
+  nb_groups    = 0;
+  perf_enabled = 0;
+}
+
+#else // __linux__
+
+void perf_init (void)
+{
+  if (perf_param != NULL)
+    fprintf (stderr, "Warning: performance counters are only supported on "
+                     "Linux, --perf-counters ignored\n");
+}
+
+void perf_finalize (void)
+{
+}
+
+void perf_register_thread (int transient)
+{
+}
+
+void perf_start (void)
+{
+}
+
+void perf_stop (unsigned nb_iter)
+{
+}
+
+#endif
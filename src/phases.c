@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "compute.h"
+#include "error.h"
+#include "global.h"
+#include "phases.h"
+
+char *phases_file = NULL;
+
+#define SUB_BITS 5
+#define SUB (1 << SUB_BITS)
+#define NB_BUCKETS ((64 - SUB_BITS) * SUB)
+
+typedef struct
+{
+  uint64_t count, sum, min, max;
+  uint64_t bucket[NB_BUCKETS];
+} histogram_t;
+
+static const char *phase_name[NB_PHASES] = {
+    "events", "compute", "sync", "refresh_img", "render", "refine", "frame"};
+
+static histogram_t histo[NB_PHASES];
+
+uint64_t phases_now (void)
+{
+  struct timespec t;
+
+  clock_gettime (CLOCK_MONOTONIC, &t);
+
+  return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+// Les valeurs inférieures à 2 * SUB ont chacune leur intervalle ; au-delà,
+// on garde les SUB_BITS bits qui suivent le bit de poids fort
+static unsigned bucket_of (uint64_t v)
+{
+  unsigned msb, shift;
+
+  if (v < 2 * SUB)
+    return v;
+
+  msb   = 63 - __builtin_clzll (v);
+  shift = msb - SUB_BITS;
+
+  return (shift + 1) * SUB + (v >> shift) - SUB;
+}
+
+static uint64_t bucket_low (unsigned b)
+{
+  unsigned shift;
+
+  if (b < 2 * SUB)
+    return b;
+
+  shift = b / SUB - 1;
+  return (uint64_t) (b % SUB + SUB) << shift;
+}
+
+static uint64_t bucket_high (unsigned b)
+{
+  return b < 2 * SUB ? b : bucket_low (b) + (1ull << (b / SUB - 1)) - 1;
+}
+
+uint64_t phases_record (int phase, uint64_t start)
+{
+  uint64_t now    = phases_now ();
+  uint64_t d      = now - start;
+  histogram_t *h  = &histo[phase];
+
+  if (h->count == 0 || d < h->min)
+    h->min = d;
+  if (d > h->max)
+    h->max = d;
+  h->count++;
+  h->sum += d;
+  h->bucket[bucket_of (d)]++;
+
+  return now;
+}
+
+// Plus petite valeur v telle qu'au moins q % des mesures sont <= v (borne
+// haute de l'intervalle, ramenée au maximum observé)
+static uint64_t percentile (histogram_t *h, double q)
+{
+  uint64_t rank = (uint64_t) (q / 100.0 * h->count + 0.5), seen = 0;
+
+  if (rank == 0)
+    rank = 1;
+
+  for (unsigned b = 0; b < NB_BUCKETS; b++) {
+    seen += h->bucket[b];
+    if (seen >= rank)
+      return bucket_high (b) < h->max ? bucket_high (b) : h->max;
+  }
+  return h->max;
+}
+
+void phases_finalize (void)
+{
+  static const double q[] = {50.0, 90.0, 99.0, 99.9};
+  FILE *f;
+
+  if (phases_file == NULL)
+    return;
+
+  for (int p = 0; p < NB_PHASES; p++) {
+    histogram_t *h = &histo[p];
+
+    if (h->count == 0)
+      continue;
+
+    fprintf (stdout,
+             "%-12s n=%-7llu mean %9.3f  p50 %9.3f  p90 %9.3f  p99 %9.3f  "
+             "max %9.3f ms\n",
+             phase_name[p], (unsigned long long)h->count,
+             h->sum / 1e6 / h->count, percentile (h, 50) / 1e6,
+             percentile (h, 90) / 1e6, percentile (h, 99) / 1e6, h->max / 1e6);
+  }
+
+  f = fopen (phases_file, "w");
+  if (f == NULL)
+    exit_with_error ("Cannot create %s\n", phases_file);
+
+  fprintf (f,
+           "{\"kernel\": \"%s\", \"variant\": \"%s\", \"dim\": %u, "
+           "\"refresh_rate\": %u, \"unit\": \"ns\",\n \"phases\": {",
+           kernel, version, DIM, refresh_rate);
+
+  for (int p = 0, sep = 0; p < NB_PHASES; p++) {
+    histogram_t *h = &histo[p];
+
+    if (h->count == 0)
+      continue;
+
+    fprintf (f,
+             "%s\n  \"%s\": {\"count\": %llu, \"sum\": %llu, \"min\": %llu, "
+             "\"max\": %llu",
+             sep ? "," : "", phase_name[p], (unsigned long long)h->count,
+             (unsigned long long)h->sum, (unsigned long long)h->min,
+             (unsigned long long)h->max);
+    for (int i = 0; i < sizeof (q) / sizeof (q[0]); i++)
+      fprintf (f, ", \"p%g\": %llu", q[i],
+               (unsigned long long)percentile (h, q[i]));
+
+    // Intervalles non vides : [borne basse, borne haute, effectif]
+    fprintf (f, ",\n   \"buckets\": [");
+    for (unsigned b = 0, first = 1; b < NB_BUCKETS; b++)
+      if (h->bucket[b]) {
+        fprintf (f, "%s[%llu, %llu, %llu]", first ? "" : ", ",
+                 (unsigned long long)bucket_low (b),
+                 (unsigned long long)bucket_high (b),
+                 (unsigned long long)h->bucket[b]);
+        first = 0;
+      }
+    fprintf (f, "]}");
+    sep = 1;
+  }
+
+  fprintf (f, "\n }\n}\n");
+  fclose (f);
+}
@@ -2,6 +2,10 @@
 #include "pthread_distrib.h"
 
 #include <errno.h>
+#include <sched.h>
+
+// Nombre de passes d'attente active avant de s'endormir sur la condition
+#define SPIN_ROUNDS 64
 
 int pthread_distrib_init (pthread_distrib_t *distrib, unsigned nb_threads,
                           unsigned nb_elements, void (*f) (void))
@@ -23,48 +27,107 @@ int pthread_distrib_init (pthread_distrib_t *distrib, unsigned nb_threads,
   }
 
   distrib->limit = nb_threads;
-  distrib->count = 0;
-  distrib->phase = 0;
+  atomic_init (&distrib->count, 0);
+  atomic_init (&distrib->phase, 0);
+  atomic_init (&distrib->sleeping, 0);
 
   distrib->total_elements = nb_elements;
-  distrib->next_element   = 0;
-  distrib->finalize_func  = f;
+  atomic_init (&distrib->next_element, 0);
+  distrib->mode          = PTHREAD_DISTRIB_CHUNK;
+  distrib->chunk         = 1;
+  distrib->finalize_func = f;
 
   return 0;
 }
 
-int pthread_distrib_get (pthread_distrib_t *distrib)
+void pthread_distrib_set_chunk (pthread_distrib_t *distrib, int mode,
+                                unsigned chunk)
 {
-  pthread_mutex_lock (&distrib->mutex);
+  distrib->mode  = mode;
+  distrib->chunk = chunk ? chunk : 1;
+}
 
-  if (distrib->next_element == distrib->total_elements) {
-    // No more job to distribute. Join barrier and return -1
+// Barrière de fin de phase : le dernier arrivé remet le distributeur à zéro,
+// appelle finalize_func puis fait avancer le compteur de phase, ce qui
+// libère les autres. Ces derniers attendent activement un court moment avant
+// de s'endormir.
+static void end_of_phase (pthread_distrib_t *distrib)
+{
+  unsigned phase = atomic_load (&distrib->phase);
+
+  if (atomic_fetch_add (&distrib->count, 1) + 1 == distrib->limit) {
+    atomic_store_explicit (&distrib->count, 0, memory_order_relaxed);
+    atomic_store_explicit (&distrib->next_element, 0, memory_order_relaxed);
 
-    distrib->count++;
-    if (distrib->count >= distrib->limit) {
-      distrib->phase++;
-      distrib->count        = 0;
-      distrib->next_element = 0;
+    if (distrib->finalize_func != NULL)
+      distrib->finalize_func ();
 
-      if (distrib->finalize_func != NULL)
-        distrib->finalize_func ();
+    atomic_store (&distrib->phase, phase + 1);
 
+    if (atomic_load (&distrib->sleeping)) {
+      pthread_mutex_lock (&distrib->mutex);
       pthread_cond_broadcast (&distrib->cond);
       pthread_mutex_unlock (&distrib->mutex);
-    } else {
-      unsigned phase = distrib->phase;
-      do
-        pthread_cond_wait (&distrib->cond, &distrib->mutex);
-      while (phase == distrib->phase);
+    }
+    return;
+  }
 
-      pthread_mutex_unlock (&distrib->mutex);
+  for (int i = 0; i < SPIN_ROUNDS; i++) {
+    if (atomic_load (&distrib->phase) != phase)
+      return;
+    sched_yield ();
+  }
+
+  atomic_fetch_add (&distrib->sleeping, 1);
+  pthread_mutex_lock (&distrib->mutex);
+  while (atomic_load (&distrib->phase) == phase)
+    pthread_cond_wait (&distrib->cond, &distrib->mutex);
+  pthread_mutex_unlock (&distrib->mutex);
+  atomic_fetch_sub (&distrib->sleeping, 1);
+}
+
+int pthread_distrib_get (pthread_distrib_t *distrib)
+{
+  unsigned e = atomic_fetch_add_explicit (&distrib->next_element, 1,
+                                          memory_order_relaxed);
+
+  if (e < distrib->total_elements)
+    return e;
+
+  // No more job to distribute. Join barrier and return -1
+  end_of_phase (distrib);
+  return -1;
+}
+
+unsigned pthread_distrib_get_chunk (pthread_distrib_t *distrib,
+                                    unsigned *first)
+{
+  unsigned total = distrib->total_elements;
+  unsigned e, n;
+
+  if (distrib->mode == PTHREAD_DISTRIB_GUIDED) {
+    // Chaque paquet vaut la part restante divisée par le nombre de threads
+    e = atomic_load_explicit (&distrib->next_element, memory_order_relaxed);
+    while (e < total) {
+      n = (total - e) / distrib->limit;
+      if (n < distrib->chunk)
+        n = distrib->chunk;
+      if (atomic_compare_exchange_weak_explicit (
+              &distrib->next_element, &e, e + n, memory_order_relaxed,
+              memory_order_relaxed))
+        break;
     }
-    return -1;
   } else {
-    // Get one element
-    int e = distrib->next_element++;
+    n = distrib->chunk;
+    e = atomic_fetch_add_explicit (&distrib->next_element, n,
+                                   memory_order_relaxed);
+  }
 
-    pthread_mutex_unlock (&distrib->mutex);
-    return e;
+  if (e < total) {
+    *first = e;
+    return e + n <= total ? n : total - e;
   }
+
+  end_of_phase (distrib);
+  return 0;
 }
@@ -0,0 +1,224 @@
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "compute.h"
+#include "error.h"
+#include "global.h"
+#include "roofline.h"
+
+unsigned do_roofline = 0;
+
+typedef void (*roofline_func_t) (double *, double *, double *);
+
+// Taille des tableaux du triad : 3 x 32 Mo, bien au-delà du dernier niveau
+// de cache des machines usuelles
+#define TRIAD_SIZE (4 * 1024 * 1024)
+#define PROBE_REPEAT 5
+#define PROBE_LANES 64
+#define PROBE_ROUNDS (1 << 21)
+
+static roofline_func_t the_roofline = NULL;
+static double bytes_start, int_start, flops_start;
+
+static volatile double sink;
+
+static double now (void)
+{
+  struct timeval t;
+
+  gettimeofday (&t, NULL);
+  return t.tv_sec + t.tv_usec / 1e6;
+}
+
+// Meilleur débit (octets/s) de a[i] = b[i] + s * c[i], en comptant comme
+// STREAM 3 accès de 8 octets par élément
+static double probe_bandwidth (void)
+{
+  double *a = malloc (TRIAD_SIZE * sizeof (double));
+  double *b = malloc (TRIAD_SIZE * sizeof (double));
+  double *c = malloc (TRIAD_SIZE * sizeof (double));
+  const double s = 3.0;
+  double best    = 0.0;
+
+  if (a == NULL || b == NULL || c == NULL)
+    exit_with_error ("Cannot allocate bandwidth probe arrays\n");
+
+  // Premier contact par les threads qui feront le calcul
+#pragma omp parallel for schedule(static)
+  for (long i = 0; i < TRIAD_SIZE; i++) {
+    a[i] = 0.0;
+    b[i] = 1.0;
+    c[i] = 2.0;
+  }
+
+  for (int r = 0; r < PROBE_REPEAT; r++) {
+    double t = now ();
+
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < TRIAD_SIZE; i++)
+      a[i] = b[i] + s * c[i];
+
+    t = now () - t;
+    if (t > 0 && 3.0 * sizeof (double) * TRIAD_SIZE / t > best)
+      best = 3.0 * sizeof (double) * TRIAD_SIZE / t;
+  }
+
+  sink = a[TRIAD_SIZE / 2];
+
+  free (a);
+  free (b);
+  free (c);
+
+  return best;
+}
+
+// Débit crête en opérations entières : des chaînes indépendantes
+// d'additions et de ou exclusifs, que le compilateur vectorise
+static double probe_int_ops (void)
+{
+  double best = 0.0;
+
+  for (int r = 0; r < PROBE_REPEAT; r++) {
+    double t       = now ();
+    unsigned nthr  = 1;
+
+#pragma omp parallel
+    {
+      uint32_t acc[PROBE_LANES];
+      uint32_t sum = 0;
+
+      for (int k = 0; k < PROBE_LANES; k++)
+        acc[k] = k + omp_get_thread_num ();
+
+      for (uint32_t n = 0; n < PROBE_ROUNDS; n++)
+        for (int k = 0; k < PROBE_LANES; k++)
+          acc[k] = (acc[k] + n) ^ (k * 0x9E37u);
+
+      for (int k = 0; k < PROBE_LANES; k++)
+        sum += acc[k];
+
+#pragma omp critical
+      sink += sum;
+#pragma omp master
+      nthr = omp_get_num_threads ();
+    }
+
+    t = now () - t;
+    if (t > 0 && 2.0 * PROBE_LANES * PROBE_ROUNDS * nthr / t > best)
+      best = 2.0 * PROBE_LANES * PROBE_ROUNDS * nthr / t;
+  }
+
+  return best;
+}
+
+// Débit crête flottant (simple précision, comme mandel) : des chaînes
+// indépendantes de multiplications-additions
+static double probe_flops (void)
+{
+  double best = 0.0;
+
+  for (int r = 0; r < PROBE_REPEAT; r++) {
+    double t      = now ();
+    unsigned nthr = 1;
+
+#pragma omp parallel
+    {
+      float acc[PROBE_LANES];
+      float sum = 0.0f;
+
+      for (int k = 0; k < PROBE_LANES; k++)
+        acc[k] = k + omp_get_thread_num ();
+
+      for (uint32_t n = 0; n < PROBE_ROUNDS; n++)
+        for (int k = 0; k < PROBE_LANES; k++)
+          acc[k] = acc[k] * 0.999999f + 1e-7f;
+
+      for (int k = 0; k < PROBE_LANES; k++)
+        sum += acc[k];
+
+#pragma omp critical
+      sink += sum;
+#pragma omp master
+      nthr = omp_get_num_threads ();
+    }
+
+    t = now () - t;
+    if (t > 0 && 2.0 * PROBE_LANES * PROBE_ROUNDS * nthr / t > best)
+      best = 2.0 * PROBE_LANES * PROBE_ROUNDS * nthr / t;
+  }
+
+  return best;
+}
+
+void roofline_init (void)
+{
+  if (!do_roofline)
+    return;
+
+  the_roofline = bind_it (kernel, "roofline", version, 0);
+
+  // Le coût d'une cellule peut évoluer pendant l'exécution (zoom de
+  // mandel) : on le relève au début et à la fin
+  if (the_roofline != NULL)
+    the_roofline (&bytes_start, &int_start, &flops_start);
+}
+
+void roofline_report (unsigned long usecs, unsigned iterations)
+{
+  double bw, peak_int, peak_flops, peak;
+  double bytes = 0.0, int_ops = 0.0, flops = 0.0, ops;
+  double cells_per_s;
+  int use_flops;
+
+  if (!do_roofline)
+    return;
+
+  bw         = probe_bandwidth ();
+  peak_int   = probe_int_ops ();
+  peak_flops = probe_flops ();
+
+  printf ("Roofline (%d threads):\n", omp_get_max_threads ());
+  printf ("  memory bandwidth (triad)  : %8.2f GB/s\n", bw / 1e9);
+  printf ("  peak integer ops          : %8.2f Gop/s\n", peak_int / 1e9);
+  printf ("  peak float ops            : %8.2f Gflop/s\n", peak_flops / 1e9);
+
+  if (the_roofline == NULL) {
+    printf ("  no cost model for kernel %s (%s_roofline)\n", kernel, kernel);
+    return;
+  }
+
+  the_roofline (&bytes, &int_ops, &flops);
+  bytes   = (bytes + bytes_start) / 2;
+  int_ops = (int_ops + int_start) / 2;
+  flops   = (flops + flops_start) / 2;
+
+  use_flops = flops > 0.0;
+  ops       = use_flops ? flops : int_ops;
+  peak      = use_flops ? peak_flops : peak_int;
+
+  cells_per_s =
+      usecs ? (double)DIM * DIM * iterations / (usecs / 1e6) : 0.0;
+
+  printf ("  cost per cell             : %.1f bytes, %.1f %s\n", bytes, ops,
+          use_flops ? "flops" : "integer ops");
+
+  if (bytes <= 0.0 || bw <= 0.0 || cells_per_s <= 0.0)
+    return;
+
+  double ai         = ops / bytes;
+  double ridge      = peak / bw;
+  double attainable = ai * bw < peak ? ai * bw : peak;
+  double achieved   = cells_per_s * ops;
+
+  printf ("  arithmetic intensity      : %8.2f op/byte (ridge point %.2f)\n",
+          ai, ridge);
+  printf ("  achieved                  : %8.3f Gcell/s, %.2f GB/s, %.2f G%s/s\n",
+          cells_per_s / 1e9, cells_per_s * bytes / 1e9, achieved / 1e9,
+          use_flops ? "flop" : "op");
+  printf ("  attainable                : %8.2f G%s/s (%s-bound), reached %.1f%%\n",
+          attainable / 1e9, use_flops ? "flop" : "op",
+          ai < ridge ? "memory" : "compute", 100.0 * achieved / attainable);
+}
@@ -1,85 +1,370 @@
 
 #define _GNU_SOURCE
 #include <hwloc.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "debug.h"
+#include "error.h"
+#include "perf.h"
 #include "scheduler.h"
 
 static int nbWorkers;
 
-volatile static int nbTask = 0;
+static atomic_int nbTask   = 0;
 pthread_mutex_t mutex      = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t cond        = PTHREAD_COND_INITIALIZER;
 
 static hwloc_topology_t topology;
 static unsigned nb_cores, numa_nodes;
 
+// Taille initiale (puissance de 2) des files, qui doublent à la demande
 #define WORK_QUEUE 1024
 
+// Nombre de tentatives de vol infructueuses, avec attente exponentielle,
+// avant qu'un worker inoccupé ne s'endorme
+#define BACKOFF_ROUNDS 10
+// Tours pendant lesquels on ne vole que sur son propre nœud NUMA
+#define LOCAL_ROUNDS 4
+
 struct task
 {
   task_func_t fun;
   void *p;
 };
 
+// Case d'une deque : lue par les voleurs pendant que le propriétaire écrit
+struct slot
+{
+  _Atomic(task_func_t) fun;
+  _Atomic(void *) p;
+};
+
+// Tableau circulaire d'une deque. Quand il déborde, le propriétaire le
+// recopie dans un tableau deux fois plus grand ; l'ancien, que des voleurs
+// peuvent encore lire, n'est libéré qu'à l'arrêt des workers (prev)
+struct deque_array
+{
+  long mask;
+  struct deque_array *prev;
+  struct slot s[];
+};
+
 struct worker
 {
   int id;
   pthread_t tid;
   pthread_attr_t attr;
-  pthread_cond_t cond;
+
+  // Deque de Chase-Lev : le propriétaire empile et dépile en bas (bottom),
+  // les voleurs prennent en haut (top)
+  atomic_long top, bottom;
+  _Atomic(struct deque_array *) deque;
+
+  // Boîte de réception des tâches soumises depuis l'extérieur (thread
+  // principal) : seul le propriétaire peut écrire dans sa deque
   pthread_mutex_t mutex;
-  int fin, todo;
-  struct task tasks[WORK_QUEUE];
-  unsigned d, f;
+  struct task *tasks;
+  unsigned d, f, size;
+  atomic_uint todo;
+
+  unsigned node; // nœud NUMA du cœur sur lequel le worker est placé
+  unsigned seed;
+  unsigned executed, stolen, stolen_remote;
 } * workers;
 
-void scheduler_task_wait ()
+static __thread struct worker *self = NULL;
+
+// Réveil des workers endormis : chaque nouvelle tâche incrémente epoch ;
+// un worker ne s'endort que si epoch n'a pas bougé depuis son dernier tour
+// de recherche
+static atomic_uint epoch     = 0;
+static atomic_int nbSleeping = 0;
+// Workers sans travail (en recherche ou endormis) : une boucle parallèle
+// ne découpe son intervalle que si l'un d'eux peut en prendre une partie
+static atomic_int nbIdle = 0;
+static atomic_int fin        = 0;
+static pthread_mutex_t sleep_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleep_cond   = PTHREAD_COND_INITIALIZER;
+
+static inline void cpu_relax (void)
 {
-  pthread_mutex_lock (&mutex);
-  while (nbTask > 0)
-    pthread_cond_wait (&cond, &mutex);
-  pthread_mutex_unlock (&mutex);
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause ();
+#endif
 }
 
-static void one_more_task ()
+static void one_less_task ()
 {
-  pthread_mutex_lock (&mutex);
-  nbTask++;
-  pthread_mutex_unlock (&mutex);
+  if (atomic_fetch_sub (&nbTask, 1) == 1) {
+    pthread_mutex_lock (&mutex);
+    pthread_cond_signal (&cond);
+    pthread_mutex_unlock (&mutex);
+  }
 }
 
-static void one_less_task ()
+static void wake_up_workers (void)
 {
-  pthread_mutex_lock (&mutex);
-  nbTask--;
-  if (nbTask == 0)
-    pthread_cond_signal (&cond);
-  pthread_mutex_unlock (&mutex);
+  atomic_fetch_add (&epoch, 1);
+  if (atomic_load (&nbSleeping) > 0) {
+    pthread_mutex_lock (&sleep_mutex);
+    pthread_cond_broadcast (&sleep_cond);
+    pthread_mutex_unlock (&sleep_mutex);
+  }
 }
 
-static void add_task (struct task todo, int w)
+//////// Deque (propriétaire)
+
+static struct deque_array *deque_array_alloc (long size)
+{
+  struct deque_array *a =
+      malloc (sizeof (struct deque_array) + size * sizeof (struct slot));
+
+  if (a == NULL)
+    exit_with_error ("Cannot allocate task deque of %ld tasks\n", size);
+  a->mask = size - 1;
+  a->prev = NULL;
+  return a;
+}
+
+static struct deque_array *deque_grow (struct worker *w,
+                                       struct deque_array *a, long s, long b)
+{
+  struct deque_array *n = deque_array_alloc (2 * (a->mask + 1));
+
+  for (long k = s; k < b; k++) {
+    atomic_store_explicit (
+        &n->s[k & n->mask].fun,
+        atomic_load_explicit (&a->s[k & a->mask].fun, memory_order_relaxed),
+        memory_order_relaxed);
+    atomic_store_explicit (
+        &n->s[k & n->mask].p,
+        atomic_load_explicit (&a->s[k & a->mask].p, memory_order_relaxed),
+        memory_order_relaxed);
+  }
+  n->prev = a;
+  atomic_store_explicit (&w->deque, n, memory_order_release);
+
+  PRINT_DEBUG ('s', "Deque of worker %d grows to %ld tasks\n", w->id,
+               n->mask + 1);
+  return n;
+}
+
+static void deque_push (struct worker *w, struct task t)
+{
+  long b = atomic_load_explicit (&w->bottom, memory_order_relaxed);
+  long s = atomic_load_explicit (&w->top, memory_order_acquire);
+  struct deque_array *a =
+      atomic_load_explicit (&w->deque, memory_order_relaxed);
+
+  if (b - s > a->mask)
+    a = deque_grow (w, a, s, b);
+
+  atomic_store_explicit (&a->s[b & a->mask].fun, t.fun, memory_order_relaxed);
+  atomic_store_explicit (&a->s[b & a->mask].p, t.p, memory_order_relaxed);
+  atomic_thread_fence (memory_order_release);
+  atomic_store_explicit (&w->bottom, b + 1, memory_order_relaxed);
+}
+
+static int deque_pop (struct worker *w, struct task *t)
+{
+  long b = atomic_load_explicit (&w->bottom, memory_order_relaxed) - 1;
+  struct deque_array *a =
+      atomic_load_explicit (&w->deque, memory_order_relaxed);
+  long s;
+  int ok = 1;
+
+  atomic_store_explicit (&w->bottom, b, memory_order_relaxed);
+  atomic_thread_fence (memory_order_seq_cst);
+  s = atomic_load_explicit (&w->top, memory_order_relaxed);
+
+  if (s > b) {
+    atomic_store_explicit (&w->bottom, b + 1, memory_order_relaxed);
+    return 0;
+  }
+
+  t->fun = atomic_load_explicit (&a->s[b & a->mask].fun, memory_order_relaxed);
+  t->p   = atomic_load_explicit (&a->s[b & a->mask].p, memory_order_relaxed);
+
+  if (s == b) {
+    // Dernière tâche : on la dispute aux voleurs
+    ok = atomic_compare_exchange_strong_explicit (
+        &w->top, &s, s + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit (&w->bottom, b + 1, memory_order_relaxed);
+  }
+  return ok;
+}
+
+//////// Deque (voleurs)
+
+static int deque_steal (struct worker *w, struct task *t)
+{
+  long s = atomic_load_explicit (&w->top, memory_order_acquire);
+  struct deque_array *a;
+  long b;
+
+  atomic_thread_fence (memory_order_seq_cst);
+  b = atomic_load_explicit (&w->bottom, memory_order_acquire);
+
+  if (s >= b)
+    return 0;
+
+  a      = atomic_load_explicit (&w->deque, memory_order_acquire);
+  t->fun = atomic_load_explicit (&a->s[s & a->mask].fun, memory_order_relaxed);
+  t->p   = atomic_load_explicit (&a->s[s & a->mask].p, memory_order_relaxed);
+
+  return atomic_compare_exchange_strong_explicit (
+      &w->top, &s, s + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+//////// Boîte de réception
+
+// Appelée verrou pris : la file est remise à plat dans un tableau deux
+// fois plus grand
+static void inbox_reserve (struct worker *w, unsigned n)
+{
+  unsigned size = w->size;
+  struct task *t;
+
+  if (w->todo + n <= size)
+    return;
+
+  while (w->todo + n > size)
+    size *= 2;
+
+  t = malloc (size * sizeof (struct task));
+  if (t == NULL)
+    exit_with_error ("Cannot allocate task queue of %u tasks\n", size);
+
+  for (unsigned k = 0; k < w->todo; k++)
+    t[k] = w->tasks[(w->d + k) % w->size];
+
+  free (w->tasks);
+  w->tasks = t;
+  w->d     = 0;
+  w->f     = w->todo;
+  w->size  = size;
+}
+
+static void inbox_put (struct worker *w, struct task *t, unsigned n)
 {
-  one_more_task ();
-  pthread_mutex_lock (&workers[w].mutex);
-  workers[w].tasks[workers[w].f] = todo;
-  workers[w].f                   = (workers[w].f + 1) % WORK_QUEUE;
-  workers[w].todo++;
-  assert (workers[w].todo < WORK_QUEUE);
-  pthread_cond_signal (&workers[w].cond);
-  pthread_mutex_unlock (&workers[w].mutex);
+  pthread_mutex_lock (&w->mutex);
+  inbox_reserve (w, n);
+  for (unsigned k = 0; k < n; k++) {
+    w->tasks[w->f] = t[k];
+    w->f           = (w->f + 1) % w->size;
+  }
+  w->todo += n;
+  pthread_mutex_unlock (&w->mutex);
 }
 
-static void no_more_task (int w)
+static int inbox_get (struct worker *w, struct task *t, int wait)
+{
+  int ok = 0;
+
+  if (wait)
+    pthread_mutex_lock (&w->mutex);
+  else if (pthread_mutex_trylock (&w->mutex))
+    return 0;
+
+  if (w->todo > 0) {
+    *t = w->tasks[w->d];
+    w->d = (w->d + 1) % w->size;
+    w->todo--;
+    ok = 1;
+  }
+  pthread_mutex_unlock (&w->mutex);
+  return ok;
+}
+
+// Le propriétaire transfère sa boîte de réception dans sa deque, où les
+// autres workers pourront voler
+static int inbox_drain (struct worker *me)
+{
+  int n = 0;
+
+  if (atomic_load (&me->todo) == 0)
+    return 0;
+
+  pthread_mutex_lock (&me->mutex);
+  while (me->todo > 0) {
+    deque_push (me, me->tasks[me->d]);
+    me->d = (me->d + 1) % me->size;
+    me->todo--;
+    n++;
+  }
+  pthread_mutex_unlock (&me->mutex);
+
+  if (n > 1)
+    wake_up_workers ();
+  return n;
+}
+
+// Vol hiérarchique : d'abord parmi les workers du même nœud NUMA, dont les
+// tuiles sont dans la même mémoire, puis (remote) sur toute la machine
+static int steal (struct worker *me, struct task *t, int remote)
+{
+  unsigned start;
+
+  if (nbWorkers == 1)
+    return 0;
+
+  me->seed = me->seed * 1103515245 + 12345;
+  start    = (me->seed >> 16) % nbWorkers;
+
+  for (int pass = 0; pass <= (remote && numa_nodes > 1); pass++)
+    for (int k = 0; k < nbWorkers; k++) {
+      struct worker *v = &workers[(start + k) % nbWorkers];
+
+      if (v == me || (v->node == me->node) == pass)
+        continue;
+      if (deque_steal (v, t) || inbox_get (v, t, 0)) {
+        if (pass)
+          me->stolen_remote++;
+        else
+          me->stolen++;
+        PRINT_DEBUG ('s', "Worker %d stole a task from worker %d%s\n",
+                     me->id, v->id, pass ? " (remote node)" : "");
+        return 1;
+      }
+    }
+  return 0;
+}
+
+static void enqueue (struct task todo, int w)
+{
+  if (self != NULL && (w == -1 || w == self->id)) {
+    deque_push (self, todo);
+    wake_up_workers ();
+    return;
+  }
+
+  if (w == -1) {
+    static atomic_uint cyclic = 0;
+    // Simple point de départ : les workers inoccupés volent ensuite les
+    // tâches de ceux qui sont en retard
+    w = atomic_fetch_add (&cyclic, 1) % nbWorkers;
+  }
+
+  inbox_put (&workers[w % nbWorkers], &todo, 1);
+  wake_up_workers ();
+}
+
+static void add_task (struct task todo, int w)
 {
-  pthread_mutex_lock (&workers[w].mutex);
-  workers[w].fin = 1;
-  pthread_cond_signal (&workers[w].cond);
-  pthread_mutex_unlock (&workers[w].mutex);
+  atomic_fetch_add (&nbTask, 1);
+  enqueue (todo, w);
 }
 
 void scheduler_create_task (task_func_t task, void *param, unsigned cpu)
@@ -89,22 +374,411 @@ void scheduler_create_task (task_func_t task, void *param, unsigned cpu)
   todo.p   = param;
   todo.fun = task;
 
-  if (cpu == -1) {
-    static int cyclic = 0;
-    // We quickly go through the list of workers to find an idle one, or the
-    // least busy one
-    PRINT_DEBUG ('s', "Dynamic task scheduling is not yet implemented\n");
-    cpu    = cyclic;
-    cyclic = (cyclic + 1) % nbWorkers;
-  }
   add_task (todo, cpu);
 }
 
+// Soumission groupée : la tâche k va au worker auquel scheduler_place
+// attribuerait la k-ième tuile d'une grille parcourue ligne par ligne, et
+// chaque worker reçoit toute sa part en une seule opération
+void scheduler_create_tasks (task_func_t task, void *params[], unsigned n)
+{
+  struct task *todo;
+  unsigned k = 0;
+
+  if (n == 0)
+    return;
+
+  todo = malloc (n * sizeof (struct task));
+  if (todo == NULL)
+    exit_with_error ("Cannot allocate %u tasks\n", n);
+
+  for (unsigned t = 0; t < n; t++) {
+    todo[t].fun = task;
+    todo[t].p   = params[t];
+  }
+
+  atomic_fetch_add (&nbTask, n);
+
+  for (int w = 0; w < nbWorkers && k < n; w++) {
+    // Tâches k .. e-1 : celles pour lesquelles k * nbWorkers / n == w
+    unsigned e = ((unsigned long)(w + 1) * n + nbWorkers - 1) / nbWorkers;
+
+    if (e > n)
+      e = n;
+    if (e == k)
+      continue;
+
+    if (self == &workers[w])
+      for (unsigned t = k; t < e; t++)
+        deque_push (self, todo[t]);
+    else
+      inbox_put (&workers[w], todo + k, e - k);
+    k = e;
+  }
+
+  free (todo);
+  wake_up_workers ();
+}
+
+static int find_task (struct worker *me, struct task *t, int remote)
+{
+  for (;;) {
+    if (deque_pop (me, t))
+      return 1;
+    if (!inbox_drain (me))
+      return steal (me, t, remote);
+  }
+}
+
+static void run_task (struct worker *me, struct task *t)
+{
+  me->executed++;
+  t->fun (t->p, me->id);
+  one_less_task ();
+}
+
+//////// Tâches avec dépendances
+
+// Successeurs rangés dans la tâche elle-même : de quoi couvrir les 9
+// voisines d'un stencil sans allocation ; au-delà, une liste chaînée
+#define SUCC_INLINE 9
+
+struct successor
+{
+  struct sched_task *task;
+  struct successor *next;
+};
+
+struct sched_task
+{
+  task_func_t fun;
+  void *p;
+  int cpu;
+  task_group_t group;
+  // Dépendances non satisfaites, plus une tant que la soumission n'est pas
+  // terminée
+  atomic_int pending;
+  atomic_flag lock; // protège done, nb_succ, succ_inline et succ
+  int done;
+  unsigned nb_succ;
+  struct sched_task *succ_inline[SUCC_INLINE];
+  struct successor *succ;
+  struct sched_task *next_in_group;
+};
+
+// Le bit GROUP_SLEEPER de count signale que celui qui attend le groupe
+// s'est endormi : la dernière tâche ne fait un appel système que dans ce
+// cas. Après sa décrémentation, une tâche ne touche plus au groupe (le
+// réveil ne fait que passer l'adresse au noyau), qui peut donc être détruit
+// dès que son compteur est vu à zéro.
+#define GROUP_SLEEPER 0x80000000u
+
+struct task_group
+{
+  atomic_uint count;
+  _Atomic(struct sched_task *) tasks;
+};
+
+// Groupe des tâches soumises sans groupe : libérées par scheduler_task_wait
+static struct task_group default_group = {0, NULL};
+
+static inline void task_lock (struct sched_task *t)
+{
+  while (atomic_flag_test_and_set_explicit (&t->lock, memory_order_acquire))
+    cpu_relax ();
+}
+
+static inline void task_unlock (struct sched_task *t)
+{
+  atomic_flag_clear_explicit (&t->lock, memory_order_release);
+}
+
+static void run_dag_task (void *p, unsigned who);
+
+static void release (struct sched_task *t)
+{
+  struct task todo = {run_dag_task, t};
+
+  enqueue (todo, t->cpu);
+}
+
+static void run_dag_task (void *p, unsigned who)
+{
+  struct sched_task *t = p;
+  task_group_t g       = t->group;
+  struct successor *s;
+  unsigned n, c;
+
+  t->fun (t->p, who);
+
+  // Une fois done positionné, plus personne n'ajoute de successeur : on peut
+  // relire succ_inline sans verrou
+  task_lock (t);
+  t->done = 1;
+  n       = t->nb_succ;
+  s       = t->succ;
+  t->succ = NULL;
+  task_unlock (t);
+
+  // Les successeurs dont c'était la dernière dépendance deviennent prêts
+  for (unsigned i = 0; i < n; i++)
+    if (atomic_fetch_sub (&t->succ_inline[i]->pending, 1) == 1)
+      release (t->succ_inline[i]);
+
+  while (s != NULL) {
+    struct successor *next = s->next;
+
+    if (atomic_fetch_sub (&s->task->pending, 1) == 1)
+      release (s->task);
+    free (s);
+    s = next;
+  }
+
+  c = atomic_fetch_sub (&g->count, 1);
+#ifdef __linux__
+  if (c == (GROUP_SLEEPER | 1))
+    syscall (SYS_futex, &g->count, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL,
+             0);
+#else
+  (void)c;
+#endif
+}
+
+task_t scheduler_submit (task_func_t task, void *param, unsigned cpu,
+                         task_group_t group, task_t *deps, unsigned nb_deps)
+{
+  struct sched_task *t = malloc (sizeof (struct sched_task));
+
+  if (t == NULL)
+    exit_with_error ("Cannot allocate task\n");
+
+  if (group == NULL)
+    group = &default_group;
+
+  t->fun   = task;
+  t->p     = param;
+  t->cpu   = cpu;
+  t->group = group;
+  t->done    = 0;
+  t->nb_succ = 0;
+  t->succ    = NULL;
+  atomic_init (&t->pending, 1);
+  atomic_flag_clear (&t->lock);
+
+  atomic_fetch_add (&group->count, 1);
+  atomic_fetch_add (&nbTask, 1);
+
+  t->next_in_group = atomic_load (&group->tasks);
+  while (!atomic_compare_exchange_weak (&group->tasks, &t->next_in_group, t))
+    ;
+
+  for (unsigned d = 0; d < nb_deps; d++) {
+    struct sched_task *dep = deps[d];
+
+    if (dep == NULL)
+      continue;
+
+    task_lock (dep);
+    if (!dep->done) {
+      if (dep->nb_succ < SUCC_INLINE)
+        dep->succ_inline[dep->nb_succ++] = t;
+      else {
+        struct successor *s = malloc (sizeof (struct successor));
+
+        if (s == NULL)
+          exit_with_error ("Cannot allocate task dependency\n");
+        s->task   = t;
+        s->next   = dep->succ;
+        dep->succ = s;
+      }
+      atomic_fetch_add (&t->pending, 1);
+    }
+    task_unlock (dep);
+  }
+
+  if (atomic_fetch_sub (&t->pending, 1) == 1)
+    release (t);
+
+  return t;
+}
+
+task_group_t scheduler_group_create (void)
+{
+  task_group_t g = malloc (sizeof (struct task_group));
+
+  if (g == NULL)
+    exit_with_error ("Cannot allocate task group\n");
+
+  atomic_init (&g->count, 0);
+  atomic_init (&g->tasks, NULL);
+
+  return g;
+}
+
+static void free_group_tasks (task_group_t g)
+{
+  struct sched_task *t = atomic_exchange (&g->tasks, NULL);
+
+  while (t != NULL) {
+    struct sched_task *n = t->next_in_group;
+    free (t);
+    t = n;
+  }
+}
+
+void scheduler_task_wait ()
+{
+  pthread_mutex_lock (&mutex);
+  while (atomic_load (&nbTask) > 0)
+    pthread_cond_wait (&cond, &mutex);
+  pthread_mutex_unlock (&mutex);
+
+  // Toutes les tâches sont terminées (nbTask n'est décrémenté qu'après
+  // run_dag_task), y compris celles du groupe par défaut
+  free_group_tasks (&default_group);
+}
+
+void scheduler_group_wait (task_group_t g)
+{
+  if (self != NULL) {
+    // Un worker n'attend pas les bras croisés : il exécute d'autres tâches
+    struct task todo;
+
+    while ((atomic_load (&g->count) & ~GROUP_SLEEPER) > 0)
+      if (find_task (self, &todo, 1))
+        run_task (self, &todo);
+      else
+        cpu_relax ();
+  } else {
+    unsigned c;
+
+    // Des tâches du groupe peuvent en soumettre d'autres pendant l'attente
+    // : le bit reste positionné jusqu'à ce que le compteur tombe à zéro
+    while (((c = atomic_load (&g->count)) & ~GROUP_SLEEPER) != 0) {
+      if (!(c & GROUP_SLEEPER)) {
+        atomic_compare_exchange_weak (&g->count, &c, c | GROUP_SLEEPER);
+        continue;
+      }
+#ifdef __linux__
+      syscall (SYS_futex, &g->count, FUTEX_WAIT_PRIVATE, c, NULL, NULL, 0);
+#else
+      sched_yield ();
+#endif
+    }
+    atomic_fetch_and (&g->count, ~GROUP_SLEEPER);
+  }
+
+  free_group_tasks (g);
+}
+
+void scheduler_group_destroy (task_group_t g)
+{
+  scheduler_group_wait (g);
+
+  free (g);
+}
+
+//////// Boucle parallèle 2D à découpage paresseux
+
+typedef struct
+{
+  range_body_t body;
+  void *arg;
+  unsigned min_size;
+  task_group_t group;
+} pfor_t;
+
+typedef struct
+{
+  pfor_t *loop;
+  range_2d_t r;
+} pfor_chunk_t;
+
+static void pfor_task (void *p, unsigned who);
+
+static void pfor_spawn (pfor_t *loop, range_2d_t r)
+{
+  pfor_chunk_t *c = malloc (sizeof (pfor_chunk_t));
+
+  if (c == NULL)
+    exit_with_error ("Cannot allocate parallel loop chunk\n");
+  c->loop = loop;
+  c->r    = r;
+  scheduler_submit (pfor_task, c, -1, loop->group, NULL, 0);
+}
+
+// Découpe selon la plus grande dimension, en restant multiple de min_size
+static int split (range_2d_t *r, range_2d_t *other, unsigned min_size)
+{
+  *other = *r;
+
+  if (r->w >= r->h && r->w >= 2 * min_size) {
+    int half = (r->w / 2) / min_size * min_size;
+
+    r->w = half;
+    other->x += half;
+    other->w -= half;
+    return 1;
+  }
+  if (r->h >= 2 * min_size) {
+    int half = (r->h / 2) / min_size * min_size;
+
+    r->h = half;
+    other->y += half;
+    other->h -= half;
+    return 1;
+  }
+  return 0;
+}
+
+// Tant que des workers sont inoccupés, on leur cède la moitié de ce qui
+// reste ; sinon on traite une bande de min_size lignes (ou colonnes) et on
+// réexamine la situation
+static void pfor_task (void *p, unsigned who)
+{
+  pfor_chunk_t *c = p;
+  pfor_t *loop    = c->loop;
+  range_2d_t r    = c->r, half, strip;
+
+  free (c);
+
+  while (r.w > 0 && r.h > 0) {
+    if (atomic_load (&nbIdle) > 0 && split (&r, &half, loop->min_size)) {
+      pfor_spawn (loop, half);
+      continue;
+    }
+
+    strip = r;
+    if (r.h > loop->min_size) {
+      strip.h = loop->min_size;
+      r.y += loop->min_size;
+      r.h -= loop->min_size;
+    } else if (r.w > loop->min_size) {
+      strip.w = loop->min_size;
+      r.x += loop->min_size;
+      r.w -= loop->min_size;
+    } else
+      r.w = 0;
+
+    loop->body (strip, loop->arg, who);
+  }
+}
+
+void scheduler_parallel_for_2d (range_2d_t range, unsigned min_size,
+                                range_body_t body, void *arg)
+{
+  pfor_t loop = {body, arg, min_size ? min_size : 1, NULL};
+
+  loop.group = scheduler_group_create ();
+  pfor_spawn (&loop, range);
+  scheduler_group_destroy (loop.group);
+}
+
 static void *worker_main (void *p)
 {
   struct worker *me = (struct worker *)p;
   struct task todo  = {NULL, NULL};
-  unsigned tasks    = 0;
+  int idle          = 1;
   hwloc_obj_t obj;
   hwloc_bitmap_t set;
 
@@ -113,34 +787,77 @@ static void *worker_main (void *p)
   // hwloc_bitmap_singlify (set);
   hwloc_set_cpubind (topology, set, HWLOC_CPUBIND_THREAD);
 
+  self = me;
+
   PRINT_DEBUG ('s', "Hey, I'm worker %d\n", me->id);
 
-  while (1) {
+  perf_register_thread (0);
 
-    pthread_mutex_lock (&me->mutex);
+  while (1) {
+    unsigned e = atomic_load (&epoch);
+    int found  = find_task (me, &todo, 0);
 
-    if (me->d == me->f && me->fin == 0)
-      pthread_cond_wait (&me->cond, &me->mutex);
+    if (!found && !idle) {
+      idle = 1;
+      atomic_fetch_add (&nbIdle, 1);
+    }
 
-    if (me->d != me->f) {
-      todo  = me->tasks[me->d];
-      me->d = (me->d + 1) % WORK_QUEUE;
-      me->todo--;
-    } else if (me->fin == 1) {
-      me->fin = -1;
+    // Attente exponentielle avant de s'endormir
+    for (int r = 0; !found && r < BACKOFF_ROUNDS; r++) {
+      for (int k = 0; k < (1 << r); k++)
+        cpu_relax ();
+      found = find_task (me, &todo, r >= LOCAL_ROUNDS);
     }
 
-    pthread_mutex_unlock (&me->mutex);
+    if (!found) {
+      if (atomic_load (&fin))
+        break;
+
+      pthread_mutex_lock (&sleep_mutex);
+      atomic_fetch_add (&nbSleeping, 1);
+      if (atomic_load (&epoch) == e && !atomic_load (&fin))
+        pthread_cond_wait (&sleep_cond, &sleep_mutex);
+      atomic_fetch_sub (&nbSleeping, 1);
+      pthread_mutex_unlock (&sleep_mutex);
+      continue;
+    }
 
-    if (me->fin == -1) {
-      PRINT_DEBUG ('s', "Worker %d has computed %d tasks\n", me->id, tasks);
-      return NULL;
+    if (idle) {
+      idle = 0;
+      atomic_fetch_sub (&nbIdle, 1);
     }
+    run_task (me, &todo);
+  }
+
+  PRINT_DEBUG ('s',
+               "Worker %d has computed %d tasks (%d stolen, %d from another "
+               "node)\n",
+               me->id, me->executed, me->stolen + me->stolen_remote,
+               me->stolen_remote);
+  return NULL;
+}
+
+static unsigned node_of_core (unsigned c)
+{
+  hwloc_obj_t core = hwloc_get_obj_by_type (topology, HWLOC_OBJ_CORE, c);
+
+  for (unsigned n = 0; n < numa_nodes; n++) {
+    hwloc_obj_t node = hwloc_get_obj_by_type (topology, HWLOC_OBJ_NUMANODE, n);
 
-    tasks++;
-    todo.fun (todo.p, me->id);
-    one_less_task ();
+    if (core != NULL && node != NULL &&
+        hwloc_bitmap_isincluded (core->cpuset, node->cpuset))
+      return n;
   }
+  return 0;
+}
+
+// Les tuiles sont réparties par blocs contigus (dans l'ordre des lignes) :
+// les workers étant placés sur des cœurs consécutifs, chaque nœud NUMA
+// reçoit une bande de l'image, la même à chaque itération et pour le
+// premier contact
+unsigned scheduler_place (unsigned i, unsigned j, unsigned ni, unsigned nj)
+{
+  return (unsigned long)(i * nj + j) * nbWorkers / (ni * nj);
 }
 
 unsigned scheduler_init (unsigned default_P)
@@ -173,20 +890,33 @@ unsigned scheduler_init (unsigned default_P)
   PRINT_DEBUG ('s', "[Starting %d workers]\n", nbWorkers);
 
   workers = malloc (nbWorkers * sizeof (struct worker));
+  atomic_store (&fin, 0);
+  atomic_store (&nbIdle, nbWorkers);
 
   for (i = 0; i < nbWorkers; i++) {
-    workers[i].id   = i;
-    workers[i].fin  = 0;
-    workers[i].todo = 0;
-    workers[i].d    = 0;
-    workers[i].f    = 0;
-    pthread_cond_init (&workers[i].cond, NULL);
+    workers[i].id            = i;
+    workers[i].todo          = 0;
+    workers[i].d             = 0;
+    workers[i].f             = 0;
+    workers[i].seed          = i + 1;
+    workers[i].executed      = 0;
+    workers[i].stolen        = 0;
+    workers[i].stolen_remote = 0;
+    workers[i].node          = node_of_core (i % nb_cores);
+    atomic_init (&workers[i].top, 0);
+    atomic_init (&workers[i].bottom, 0);
+    atomic_init (&workers[i].deque, deque_array_alloc (WORK_QUEUE));
+    workers[i].size  = WORK_QUEUE;
+    workers[i].tasks = malloc (WORK_QUEUE * sizeof (struct task));
     pthread_mutex_init (&workers[i].mutex, NULL);
     pthread_attr_init (&workers[i].attr);
+  }
 
+  // Les workers peuvent se voler dès leur démarrage : ils sont tous
+  // initialisés avant d'être lancés
+  for (i = 0; i < nbWorkers; i++)
     pthread_create (&workers[i].tid, &workers[i].attr, worker_main,
                     &workers[i]);
-  }
 
   return nbWorkers;
 }
@@ -195,12 +925,24 @@ void scheduler_finalize (void)
 {
   int i;
 
-  for (i = 0; i < nbWorkers; i++)
-    no_more_task (i);
+  atomic_store (&fin, 1);
+  wake_up_workers ();
 
   for (i = 0; i < nbWorkers; i++)
     pthread_join (workers[i].tid, NULL);
 
+  for (i = 0; i < nbWorkers; i++) {
+    struct deque_array *a = atomic_load (&workers[i].deque);
+
+    while (a != NULL) {
+      struct deque_array *prev = a->prev;
+      free (a);
+      a = prev;
+    }
+    free (workers[i].tasks);
+    pthread_mutex_destroy (&workers[i].mutex);
+  }
+
   free (workers);
 
   /* Destroy topology object. */
@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "compute.h"
+#include "debug.h"
+#include "error.h"
+#include "global.h"
+#include "monitoring.h"
+#include "trace.h"
+
+#define TRACE_CHUNK 4096
+
+typedef struct trace_chunk
+{
+  struct trace_chunk *next;
+  unsigned nb;
+  trace_event_t ev[TRACE_CHUNK];
+} trace_chunk_t;
+
+typedef struct trace_buffer
+{
+  struct trace_buffer *next;
+  unsigned thread;
+  trace_chunk_t *first, *last;
+  // Position de la dernière relecture (trace_replay)
+  trace_chunk_t *replay_chunk;
+  unsigned replay_index;
+} trace_buffer_t;
+
+unsigned do_trace          = 0;
+unsigned trace_enabled     = 0;
+char *trace_prefix         = NULL;
+unsigned trace_iteration   = 0;
+__thread uint64_t trace_tile_start = 0;
+
+static struct timespec trace_origin;
+static _Atomic(trace_buffer_t *) buffers = NULL;
+static atomic_uint nb_buffers            = 0;
+static __thread trace_buffer_t *my_buffer = NULL;
+
+uint64_t trace_now (void)
+{
+  struct timespec t;
+
+  clock_gettime (CLOCK_MONOTONIC, &t);
+
+  return (uint64_t) (t.tv_sec - trace_origin.tv_sec) * 1000000000ull +
+         t.tv_nsec - trace_origin.tv_nsec;
+}
+
+void trace_init (void)
+{
+  trace_enabled = do_trace || (do_monitoring && display);
+  clock_gettime (CLOCK_MONOTONIC, &trace_origin);
+}
+
+static trace_chunk_t *new_chunk (void)
+{
+  trace_chunk_t *c = malloc (sizeof (trace_chunk_t));
+
+  if (c == NULL)
+    exit_with_error ("Cannot allocate trace buffer\n");
+  c->next = NULL;
+  c->nb   = 0;
+  return c;
+}
+
+// Premier événement d'un thread : son tampon est ajouté en tête de la liste
+static trace_buffer_t *register_thread (void)
+{
+  trace_buffer_t *b = malloc (sizeof (trace_buffer_t));
+
+  if (b == NULL)
+    exit_with_error ("Cannot allocate trace buffer\n");
+
+  b->thread       = atomic_fetch_add (&nb_buffers, 1);
+  b->first        = new_chunk ();
+  b->last         = b->first;
+  b->replay_chunk = b->first;
+  b->replay_index = 0;
+
+  b->next = atomic_load (&buffers);
+  while (!atomic_compare_exchange_weak (&buffers, &b->next, b))
+    ;
+
+  PRINT_DEBUG ('m', "Trace buffer %u registered\n", b->thread);
+
+  return b;
+}
+
+void trace_record (int x, int y, int w, int h, int who)
+{
+  trace_buffer_t *b = my_buffer;
+  trace_event_t *e;
+
+  if (b == NULL)
+    b = my_buffer = register_thread ();
+
+  if (b->last->nb == TRACE_CHUNK) {
+    trace_chunk_t *c = new_chunk ();
+    b->last->next    = c;
+    b->last          = c;
+  }
+
+  e            = &b->last->ev[b->last->nb];
+  e->start     = trace_tile_start;
+  e->end       = trace_now ();
+  e->x         = x;
+  e->y         = y;
+  e->w         = w;
+  e->h         = h;
+  e->who       = who;
+  e->iteration = trace_iteration;
+#ifdef __linux__
+  e->cpu = sched_getcpu ();
+#else
+  e->cpu = -1;
+#endif
+
+  b->last->nb++;
+}
+
+void trace_replay (trace_replay_func_t f)
+{
+  for (trace_buffer_t *b = atomic_load (&buffers); b != NULL; b = b->next) {
+    unsigned from = b->replay_index;
+
+    for (trace_chunk_t *c = b->replay_chunk; c != NULL; c = c->next) {
+      for (unsigned i = from; i < c->nb; i++)
+        f (&c->ev[i]);
+      b->replay_chunk = c;
+      b->replay_index = c->nb;
+      from            = 0;
+    }
+
+    // Sans export, les événements relus ne servent plus : on recycle
+    if (!do_trace) {
+      trace_chunk_t *c = b->first->next;
+
+      while (c != NULL) {
+        trace_chunk_t *n = c->next;
+        free (c);
+        c = n;
+      }
+      b->first->next  = NULL;
+      b->first->nb    = 0;
+      b->last         = b->first;
+      b->replay_chunk = b->first;
+      b->replay_index = 0;
+    }
+  }
+}
+
+///////////////////////////// Export
+
+static FILE *open_output (const char *suffix)
+{
+  char filename[1024];
+  FILE *f;
+
+  snprintf (filename, sizeof (filename), "%s.%s", trace_prefix, suffix);
+  f = fopen (filename, "w");
+  if (f == NULL)
+    exit_with_error ("Cannot create trace file %s\n", filename);
+
+  printf ("Trace written to %s\n", filename);
+  return f;
+}
+
+static void export_chrome (void)
+{
+  FILE *f  = open_output ("json");
+  int sep  = 0;
+
+  fprintf (f, "{\"otherData\": {\"kernel\": \"%s\", \"variant\": \"%s\", "
+              "\"dim\": %u, \"grain\": %u},\n",
+           kernel, version, DIM, GRAIN);
+  fprintf (f, "\"displayTimeUnit\": \"ns\",\n\"traceEvents\": [");
+
+  for (trace_buffer_t *b = atomic_load (&buffers); b != NULL; b = b->next) {
+    fprintf (f,
+             "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+             "\"tid\": %u, \"args\": {\"name\": \"thread %u\"}}",
+             sep ? "," : "", b->thread, b->thread);
+    sep = 1;
+
+    for (trace_chunk_t *c = b->first; c != NULL; c = c->next)
+      for (unsigned i = 0; i < c->nb; i++) {
+        trace_event_t *e = &c->ev[i];
+
+        fprintf (f,
+                 ",\n{\"name\": \"tile\", \"cat\": \"%s\", \"ph\": \"X\", "
+                 "\"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, "
+                 "\"args\": {\"x\": %d, \"y\": %d, \"w\": %d, \"h\": %d, "
+                 "\"who\": %d, \"cpu\": %d, \"iteration\": %u}}",
+                 version, b->thread, e->start / 1000.0,
+                 (e->end - e->start) / 1000.0, e->x, e->y, e->w, e->h,
+                 e->who, e->cpu, e->iteration);
+      }
+  }
+
+  fprintf (f, "\n]}\n");
+  fclose (f);
+}
+
+// Paje impose un ordre chronologique global : on fusionne les débuts et
+// fins de tuiles de tous les threads
+typedef struct
+{
+  uint64_t time;
+  unsigned thread;
+  int start;
+} paje_event_t;
+
+static int paje_cmp (const void *a, const void *b)
+{
+  const paje_event_t *x = a, *y = b;
+
+  if (x->time != y->time)
+    return x->time < y->time ? -1 : 1;
+  return x->start - y->start; // une fin avant un début simultané
+}
+
+static void export_paje (void)
+{
+  FILE *f          = open_output ("paje");
+  size_t nb        = 0, n = 0;
+  uint64_t last    = 0;
+  paje_event_t *ev;
+
+  for (trace_buffer_t *b = atomic_load (&buffers); b != NULL; b = b->next)
+    for (trace_chunk_t *c = b->first; c != NULL; c = c->next)
+      nb += 2 * c->nb;
+
+  ev = malloc ((nb ? nb : 1) * sizeof (paje_event_t));
+  if (ev == NULL)
+    exit_with_error ("Cannot allocate Paje events\n");
+
+  for (trace_buffer_t *b = atomic_load (&buffers); b != NULL; b = b->next)
+    for (trace_chunk_t *c = b->first; c != NULL; c = c->next)
+      for (unsigned i = 0; i < c->nb; i++) {
+        ev[n++] = (paje_event_t){c->ev[i].start, b->thread, 1};
+        ev[n++] = (paje_event_t){c->ev[i].end, b->thread, 0};
+        if (c->ev[i].end > last)
+          last = c->ev[i].end;
+      }
+
+  qsort (ev, nb, sizeof (paje_event_t), paje_cmp);
+
+  fprintf (f, "%%EventDef PajeDefineContainerType 0\n%%\tAlias string\n"
+              "%%\tType string\n%%\tName string\n%%EndEventDef\n");
+  fprintf (f, "%%EventDef PajeDefineStateType 1\n%%\tAlias string\n"
+              "%%\tType string\n%%\tName string\n%%EndEventDef\n");
+  fprintf (f, "%%EventDef PajeDefineEntityValue 2\n%%\tAlias string\n"
+              "%%\tType string\n%%\tName string\n%%\tColor color\n"
+              "%%EndEventDef\n");
+  fprintf (f, "%%EventDef PajeCreateContainer 3\n%%\tTime date\n"
+              "%%\tAlias string\n%%\tType string\n%%\tContainer string\n"
+              "%%\tName string\n%%EndEventDef\n");
+  fprintf (f, "%%EventDef PajeDestroyContainer 4\n%%\tTime date\n"
+              "%%\tType string\n%%\tName string\n%%EndEventDef\n");
+  fprintf (f, "%%EventDef PajeSetState 5\n%%\tTime date\n%%\tType string\n"
+              "%%\tContainer string\n%%\tValue string\n%%EndEventDef\n");
+
+  fprintf (f, "0 P 0 Program\n0 T P Thread\n1 S T \"Thread state\"\n");
+  fprintf (f, "2 W S Working \"0.0 0.8 0.0\"\n2 I S Idle \"0.8 0.8 0.8\"\n");
+  fprintf (f, "3 0.000000000 p P 0 \"%s %s\"\n", kernel, version);
+
+  for (unsigned t = 0; t < atomic_load (&nb_buffers); t++)
+    fprintf (f, "3 0.000000000 t%u T p \"thread %u\"\n5 0.000000000 S t%u I\n",
+             t, t, t);
+
+  for (size_t i = 0; i < nb; i++)
+    fprintf (f, "5 %.9f S t%u %c\n", ev[i].time / 1e9, ev[i].thread,
+             ev[i].start ? 'W' : 'I');
+
+  for (unsigned t = 0; t < atomic_load (&nb_buffers); t++)
+    fprintf (f, "4 %.9f T t%u\n", last / 1e9, t);
+  fprintf (f, "4 %.9f P p\n", last / 1e9);
+
+  free (ev);
+  fclose (f);
+}
+
+void trace_finalize (void)
+{
+  trace_buffer_t *b;
+
+  if (do_trace) {
+    export_chrome ();
+    export_paje ();
+  }
+
+  b = atomic_load (&buffers);
+  while (b != NULL) {
+    trace_buffer_t *nb = b->next;
+    trace_chunk_t *c   = b->first;
+
+    while (c != NULL) {
+      trace_chunk_t *n = c->next;
+      free (c);
+      c = n;
+    }
+    free (b);
+    b = nb;
+  }
+  atomic_store (&buffers, NULL);
+  trace_enabled = 0;
+}
@@ -0,0 +1,361 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compute.h"
+#include "debug.h"
+#include "error.h"
+#include "global.h"
+#include "graphics.h"
+#include "ocl.h"
+#include "validate.h"
+
+#ifdef ENABLE_VECTO
+#include <immintrin.h>
+#endif
+
+unsigned validate_period = 0;
+char *validate_golden    = NULL;
+
+// Les empreintes sont calculées sur des tuiles de taille fixe, indépendante
+// de GRAIN, pour qu'un fichier de référence serve quel que soit le grain
+#define VALIDATE_TILE 64
+#define HASH_LANES 8
+#define HASH_MUL 0x9E3779B1u
+
+typedef void (*state_func_t) (int);
+
+static const uint32_t lane_seed[HASH_LANES] = {
+    0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344,
+    0xA4093822, 0x299F31D0, 0x082EFA98, 0xEC4E6C89};
+
+static unsigned tile_size, nb_tiles_x, nb_tiles;
+static uint64_t *ref_hash = NULL, *var_hash = NULL;
+
+static inline uint32_t lane_mix (uint32_t h, uint32_t v)
+{
+  h = (h ^ v) * HASH_MUL;
+  return h ^ (h >> 15);
+}
+
+// Chaque colonne de la tuile alimente la voie (x mod HASH_LANES) : la
+// version AVX2 et la version scalaire donnent exactement le même résultat
+static uint64_t hash_tile (const Uint32 *img, int y0, int x0, int h, int w)
+{
+  uint32_t lane[HASH_LANES];
+  uint64_t res = 0xCBF29CE484222325ull;
+
+#if defined(ENABLE_VECTO) && VEC_SIZE == 8
+  const int wv        = w & ~(HASH_LANES - 1);
+  const int r         = w - wv;
+  const __m256i mul   = _mm256_set1_epi32 (HASH_MUL);
+  const __m256i mask  = _mm256_cmpgt_epi32 (_mm256_set1_epi32 (r),
+                                           _mm256_setr_epi32 (0, 1, 2, 3, 4,
+                                                              5, 6, 7));
+  __m256i acc = _mm256_loadu_si256 ((const __m256i *)lane_seed);
+
+  for (int y = y0; y < y0 + h; y++) {
+    const Uint32 *row = img + y * DIM + x0;
+    __m256i v;
+
+    for (int x = 0; x < wv; x += HASH_LANES) {
+      v   = _mm256_loadu_si256 ((const __m256i *)(row + x));
+      acc = _mm256_mullo_epi32 (_mm256_xor_si256 (acc, v), mul);
+      acc = _mm256_xor_si256 (acc, _mm256_srli_epi32 (acc, 15));
+    }
+    if (r) {
+      // Fin de ligne : seules les r premières voies sont mises à jour
+      __m256i n;
+
+      v = _mm256_maskload_epi32 ((const int *)(row + wv), mask);
+      n = _mm256_mullo_epi32 (_mm256_xor_si256 (acc, v), mul);
+      n = _mm256_xor_si256 (n, _mm256_srli_epi32 (n, 15));
+      acc = _mm256_blendv_epi8 (acc, n, mask);
+    }
+  }
+  _mm256_storeu_si256 ((__m256i *)lane, acc);
+#else
+  memcpy (lane, lane_seed, sizeof (lane));
+
+  for (int y = y0; y < y0 + h; y++) {
+    const Uint32 *row = img + y * DIM + x0;
+
+    for (int x = 0; x < w; x++)
+      lane[x % HASH_LANES] = lane_mix (lane[x % HASH_LANES], row[x]);
+  }
+#endif
+
+  for (int l = 0; l < HASH_LANES; l++)
+    res = (res ^ lane[l]) * 0x100000001B3ull;
+
+  return res;
+}
+
+static void tile_bounds (unsigned t, int *y0, int *x0, int *h, int *w)
+{
+  *y0 = (t / nb_tiles_x) * tile_size;
+  *x0 = (t % nb_tiles_x) * tile_size;
+  *h  = (*y0 + tile_size > DIM) ? DIM - *y0 : tile_size;
+  *w  = (*x0 + tile_size > DIM) ? DIM - *x0 : tile_size;
+}
+
+static void hash_image (const Uint32 *img, uint64_t *hash)
+{
+#pragma omp parallel for schedule(static)
+  for (unsigned t = 0; t < nb_tiles; t++) {
+    int y0, x0, h, w;
+
+    tile_bounds (t, &y0, &x0, &h, &w);
+    hash[t] = hash_tile (img, y0, x0, h, w);
+  }
+}
+
+static void report (unsigned gen, unsigned prev, const Uint32 *ref_img)
+{
+  unsigned first = nb_tiles, count = 0;
+  int y0, x0, h, w;
+
+  for (unsigned t = 0; t < nb_tiles; t++)
+    if (ref_hash[t] != var_hash[t]) {
+      if (first == nb_tiles)
+        first = t;
+      count++;
+    }
+
+  tile_bounds (first, &y0, &x0, &h, &w);
+
+  fprintf (stderr,
+           "Validation failed: divergence at generation %u (last match at "
+           "generation %u)\n",
+           gen, prev);
+  fprintf (stderr,
+           "  first tile (%d, %d) = cells [%d..%d] x [%d..%d], %u/%u tiles "
+           "differ\n",
+           y0 / tile_size, x0 / tile_size, y0, y0 + h - 1, x0, x0 + w - 1,
+           count, nb_tiles);
+
+  if (ref_img != NULL)
+    for (int y = y0; y < y0 + h; y++)
+      for (int x = x0; x < x0 + w; x++)
+        if (ref_img[y * DIM + x] != image[y * DIM + x]) {
+          fprintf (stderr,
+                   "  first cell (%d, %d): reference 0x%08X, variant "
+                   "0x%08X\n",
+                   y, x, ref_img[y * DIM + x], image[y * DIM + x]);
+          return;
+        }
+}
+
+// Fichier de référence : une ligne d'en-tête décrivant l'expérience, puis
+// une ligne par point de contrôle (génération suivie des empreintes)
+static FILE *golden_open (int *recording)
+{
+  char expected[1024], header[1024];
+  FILE *f;
+
+  snprintf (expected, sizeof (expected), "%s %u %u %u %s\n", kernel, DIM,
+            tile_size, validate_period,
+            draw_param != NULL ? draw_param : "-");
+
+  f = fopen (validate_golden, "r");
+  if (f != NULL) {
+    *recording = 0;
+    if (fgets (header, sizeof (header), f) == NULL || strcmp (header, expected))
+      exit_with_error ("%s was recorded with different parameters "
+                       "(kernel, DIM, tile, period, arg): %s",
+                       validate_golden, header);
+    return f;
+  }
+
+  f = fopen (validate_golden, "w");
+  if (f == NULL)
+    exit_with_error ("Cannot create golden hash file %s\n", validate_golden);
+  *recording = 1;
+  fputs (expected, f);
+  return f;
+}
+
+// Renvoie 1 si le fichier est épuisé
+static int golden_check (FILE *f, int recording, unsigned gen)
+{
+  unsigned g;
+
+  if (recording) {
+    fprintf (f, "%u", gen);
+    for (unsigned t = 0; t < nb_tiles; t++)
+      fprintf (f, " %016llx", (unsigned long long)var_hash[t]);
+    fputc ('\n', f);
+    return 0;
+  }
+
+  if (fscanf (f, "%u", &g) != 1)
+    return 1;
+  if (g != gen)
+    exit_with_error ("%s: expected generation %u, found %u\n",
+                     validate_golden, gen, g);
+
+  for (unsigned t = 0; t < nb_tiles; t++) {
+    unsigned long long h;
+
+    if (fscanf (f, "%llx", &h) != 1)
+      exit_with_error ("%s: truncated line for generation %u\n",
+                       validate_golden, gen);
+    ref_hash[t] = h;
+  }
+  return 0;
+}
+
+// Exécute la version de référence sur ses propres images
+static unsigned run_reference (int_func_t ref, void_func_t ref_refresh,
+                               Uint32 **cur, Uint32 **alt, unsigned nb_iter)
+{
+  Uint32 *var_cur = image, *var_alt = alt_image;
+  unsigned n;
+
+  image     = *cur;
+  alt_image = *alt;
+  n         = ref (nb_iter);
+  if (ref_refresh != NULL)
+    ref_refresh ();
+  *cur      = image;
+  *alt      = alt_image;
+
+  image     = var_cur;
+  alt_image = var_alt;
+  return n;
+}
+
+int validate_run (int *iterations)
+{
+  int_func_t ref          = NULL;
+  void_func_t ref_refresh = NULL;
+  state_func_t state      = NULL;
+  Uint32 *ref_cur = NULL, *ref_alt = NULL;
+  FILE *golden  = NULL;
+  int recording = 0, failed = 0, exhausted = 0;
+  unsigned gen = 0, prev = 0;
+
+  if (max_iter <= 0)
+    exit_with_error ("--validate needs a number of iterations (-i)\n");
+
+  tile_size  = DIM < VALIDATE_TILE ? DIM : VALIDATE_TILE;
+  nb_tiles_x = (DIM + tile_size - 1) / tile_size;
+  nb_tiles   = nb_tiles_x * nb_tiles_x;
+  ref_hash   = malloc (nb_tiles * sizeof (uint64_t));
+  var_hash   = malloc (nb_tiles * sizeof (uint64_t));
+
+  if (validate_golden != NULL)
+    golden = golden_open (&recording);
+  else {
+    ref = bind_it (kernel, "compute", "seq", 0);
+    if (ref == NULL || ref == the_compute)
+      exit_with_error ("No reference version %s_compute_seq to validate "
+                       "against (use --golden)\n",
+                       kernel);
+    state       = bind_it (kernel, "validate_state", version, 0);
+    ref_refresh = bind_it (kernel, "refresh_img", "seq", 0);
+
+    ref_cur = malloc (DIM * DIM * sizeof (Uint32));
+    ref_alt = malloc (DIM * DIM * sizeof (Uint32));
+    memcpy (ref_cur, image, DIM * DIM * sizeof (Uint32));
+    memcpy (ref_alt, alt_image, DIM * DIM * sizeof (Uint32));
+  }
+
+  printf ("Validating variant [%s] against %s every %u generations\n",
+          version, golden != NULL ? validate_golden : "seq", validate_period);
+
+  for (;;) {
+    hash_image (image, var_hash);
+    if (golden != NULL)
+      exhausted = golden_check (golden, recording, gen);
+    else
+      hash_image (ref_cur, ref_hash);
+
+    if (exhausted) {
+      printf ("%s ends at generation %u\n", validate_golden, prev);
+      gen = prev;
+      break;
+    }
+
+    if (memcmp (ref_hash, var_hash, nb_tiles * sizeof (uint64_t)) &&
+        !recording) {
+      report (gen, prev, ref_cur);
+      failed = 1;
+      break;
+    }
+
+    if (gen >= max_iter)
+      break;
+
+    unsigned nb_iter = validate_period;
+    unsigned n_ref = 0, n_var;
+
+    if (gen + nb_iter > max_iter)
+      nb_iter = max_iter - gen;
+
+    if (ref != NULL) {
+      if (state != NULL)
+        state (1);
+      n_ref = run_reference (ref, ref_refresh, &ref_cur, &ref_alt, nb_iter);
+      if (state != NULL)
+        state (0);
+    }
+
+    n_var = the_compute (nb_iter);
+    if (opencl_used) {
+      ocl_wait ();
+      ocl_retrieve_image (image);
+    }
+    // Les noyaux qui calculent hors de image (mandel) y reportent le résultat
+    if (the_refresh_img != NULL)
+      the_refresh_img ();
+
+    prev = gen;
+
+    if (ref != NULL && n_ref != n_var) {
+      fprintf (stderr,
+               "Validation failed: between generations %u and %u, reference "
+               "reports %u, variant reports %u\n",
+               gen, gen + nb_iter, n_ref, n_var);
+      failed = 1;
+      break;
+    }
+
+    if (n_var > 0) {
+      // Stabilisation : dernière comparaison puis arrêt
+      gen += n_var;
+      hash_image (image, var_hash);
+      if (golden != NULL)
+        exhausted = golden_check (golden, recording, gen);
+      else
+        hash_image (ref_cur, ref_hash);
+      if (exhausted)
+        gen = prev;
+      else if (!recording &&
+          memcmp (ref_hash, var_hash, nb_tiles * sizeof (uint64_t))) {
+        report (gen, prev, ref_cur);
+        failed = 1;
+      }
+      break;
+    }
+
+    gen += nb_iter;
+  }
+
+  if (!failed)
+    printf ("Validation %s: %u generations checked, %u tiles of %ux%u\n",
+            recording ? "hashes recorded" : "OK", gen, nb_tiles, tile_size,
+            tile_size);
+
+  *iterations = gen;
+
+  if (golden != NULL)
+    fclose (golden);
+  free (ref_cur);
+  free (ref_alt);
+  free (ref_hash);
+  free (var_hash);
+
+  return failed;
+}
@@ -1,8 +1,10 @@
 
 #include "compute.h"
+#include "constants.h"
 #include "debug.h"
 #include "global.h"
 #include "graphics.h"
+#include "monitoring.h"
 #include "ocl.h"
 #include "scheduler.h"
 
@@ -10,7 +12,12 @@
 	#include "mpi.h"
 #endif
 
+#include <omp.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 static int compute_new_state_old(int y, int x)
 {
@@ -51,35 +58,51 @@ static int compute_new_state_old(int y, int x)
 	return change;
 }
 
-// Compute new_state avec moins de sauts conditionnels
-static int compute_new_state(int y, int x)
+// Compute new_state avec moins de sauts conditionnels, de l'image src vers
+// l'image dst
+static int compute_new_state_in(Uint32 *restrict src, Uint32 *restrict dst, int y, int x)
 {
 	unsigned n = 0;
 	unsigned change = 0;
 
-	n += (cur_img(y - 1, x - 1) != 0);
-	n += (cur_img(y - 1, x) != 0);
-	n += (cur_img(y - 1, x + 1) != 0);
-	n += (cur_img(y, x - 1) != 0);
-	n += (cur_img(y, x + 1) != 0);
-	n += (cur_img(y + 1, x - 1) != 0);
-	n += (cur_img(y + 1, x) != 0);
-	n += (cur_img(y + 1, x + 1) != 0);
-
-	// On laisse un 'if' pour éviter 2 appels à cur_img
-	if (cur_img(y, x) != 0){
+	n += (*img_cell(src, y - 1, x - 1) != 0);
+	n += (*img_cell(src, y - 1, x) != 0);
+	n += (*img_cell(src, y - 1, x + 1) != 0);
+	n += (*img_cell(src, y, x - 1) != 0);
+	n += (*img_cell(src, y, x + 1) != 0);
+	n += (*img_cell(src, y + 1, x - 1) != 0);
+	n += (*img_cell(src, y + 1, x) != 0);
+	n += (*img_cell(src, y + 1, x + 1) != 0);
+
+	// On laisse un 'if' pour éviter 2 accès à la cellule
+	if (*img_cell(src, y, x) != 0){
 		n = (n == 2 || n == 3) * 0xFFFF00FF;
 	}else{
 		n = (n == 3) * 0xFFFF00FF;
 	}
 
-	change = (cur_img(y, x) != n);
+	change = (*img_cell(src, y, x) != n);
 
-	next_img(y, x) = n;
+	*img_cell(dst, y, x) = n;
 
 	return change;
 }
 
+static int compute_new_state(int y, int x)
+{
+	return compute_new_state_in(image, alt_image, y, x);
+}
+
+// Coût d'une cellule pour --roofline : une lecture et une écriture (plus
+// l'allocation de la ligne en écriture), les voisins étant dans le cache ;
+// 9 comparaisons, 8 additions et environ 5 opérations pour la règle
+void vie_roofline(double *bytes, double *int_ops, double *flops)
+{
+	*bytes = 3 * sizeof(unsigned);
+	*int_ops = 22;
+	*flops = 0;
+}
+
 
 // ============================== Version séquentielle d'origine ==============================
 
@@ -89,10 +112,15 @@ static int traiter_tuile(int i_d, int j_d, int i_f, int j_f)
 
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
+	monitoring_start_tile();
+
 	for (int i = i_d; i <= i_f; i++)
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state_old(i, j);
 
+	monitoring_end_tile(j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, omp_get_thread_num());
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -125,9 +153,11 @@ unsigned vie_compute_seq_base(unsigned nb_iter)
 	for (unsigned it = 1; it <= nb_iter; it++){
 
 		for (int i = 1; i < DIM-1; i++){
+			monitoring_start_tile();
 			for (int j = 1; j < DIM-1; j++){
 				change |= compute_new_state(i, j);
 			}
+			monitoring_end_tile(1, i, DIM - 2, 1, omp_get_thread_num());
 		}
 
 		swap_images();
@@ -150,10 +180,14 @@ static int traiter_tuile_seq_tiled(int i_d, int j_d, int i_f, int j_f)
 
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
+	monitoring_start_tile();
+
 	for (int i = i_d; i <= i_f; i++)
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
-		
+
+	monitoring_end_tile(j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, omp_get_thread_num());
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
 
 	return change;
 }
@@ -196,10 +230,14 @@ static int traiter_tuile_seq_tiled_opt(int i_d, int j_d, int i_f, int j_f)
 
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
+	monitoring_start_tile();
+
 	for (int i = i_d; i <= i_f; i++)
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
-		
+
+	monitoring_end_tile(j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, omp_get_thread_num());
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
 
 	return change;
 }
@@ -285,9 +323,11 @@ unsigned vie_compute_omp_base_static(unsigned nb_iter)
 
 		#pragma omp parallel for schedule (static) reduction(|:change)
 		for (int i = 1; i < DIM-1; i++){
+			monitoring_start_tile();
 			for (int j = 1; j < DIM-1; j++){
 				change |= compute_new_state(i, j);
 			}
+			monitoring_end_tile(1, i, DIM - 2, 1, omp_get_thread_num());
 		}
 
 		swap_images();
@@ -312,9 +352,11 @@ unsigned vie_compute_omp_base_cyclic(unsigned nb_iter)
 
 		#pragma omp parallel for schedule (static, 2) reduction(|:change)
 		for (int i = 1; i < DIM-1; i++){
+			monitoring_start_tile();
 			for (int j = 1; j < DIM-1; j++){
 				change |= compute_new_state(i, j);
 			}
+			monitoring_end_tile(1, i, DIM - 2, 1, omp_get_thread_num());
 		}
 
 		swap_images();
@@ -339,9 +381,11 @@ unsigned vie_compute_omp_base_dynamic(unsigned nb_iter)
 
 		#pragma omp parallel for schedule (dynamic, 1) reduction(|:change)
 		for (int i = 1; i < DIM-1; i++){
+			monitoring_start_tile();
 			for (int j = 1; j < DIM-1; j++){
 				change |= compute_new_state(i, j);
 			}
+			monitoring_end_tile(1, i, DIM - 2, 1, omp_get_thread_num());
 		}
 
 		swap_images();
@@ -364,11 +408,18 @@ unsigned vie_compute_omp_base_collapse(unsigned nb_iter)
 	
 	for (unsigned it = 1; it <= nb_iter; it++){
 
-		#pragma omp parallel for collapse(2) schedule(static) reduction(|:change)
-		for (int i = 1; i < DIM-1; i++){
-			for (int j = 1; j < DIM-1; j++){
-				change |= compute_new_state(i, j);
+		#pragma omp parallel reduction(|:change)
+		{
+			monitoring_start_tile();
+
+			#pragma omp for collapse(2) schedule(static) nowait
+			for (int i = 1; i < DIM-1; i++){
+				for (int j = 1; j < DIM-1; j++){
+					change |= compute_new_state(i, j);
+				}
 			}
+
+			monitoring_end_tile(1, 1, DIM - 2, DIM - 2, omp_get_thread_num());
 		}
 
 		swap_images();
@@ -391,11 +442,16 @@ static int traiter_tuile_omp_tiled_static(int i_d, int j_d, int i_f, int j_f)
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
 	#pragma omp parallel for schedule(static) reduction(|:change)
-	for (int i = i_d; i <= i_f; i++)
+	for (int i = i_d; i <= i_f; i++){
+		monitoring_start_tile();
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
+		monitoring_end_tile(j_d, i, j_f - j_d + 1, 1, omp_get_thread_num());
+	}
 		
 
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -437,11 +493,16 @@ static int traiter_tuile_omp_tiled_cyclic(int i_d, int j_d, int i_f, int j_f)
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
 	#pragma omp parallel for schedule(static, 1) reduction(|:change)
-	for (int i = i_d; i <= i_f; i++)
+	for (int i = i_d; i <= i_f; i++){
+		monitoring_start_tile();
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
+		monitoring_end_tile(j_d, i, j_f - j_d + 1, 1, omp_get_thread_num());
+	}
 		
 
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -483,11 +544,16 @@ static int traiter_tuile_omp_tiled_dynamic(int i_d, int j_d, int i_f, int j_f)
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
 	#pragma omp parallel for schedule(dynamic, 1) reduction(|:change)
-	for (int i = i_d; i <= i_f; i++)
+	for (int i = i_d; i <= i_f; i++){
+		monitoring_start_tile();
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
+		monitoring_end_tile(j_d, i, j_f - j_d + 1, 1, omp_get_thread_num());
+	}
 		
 
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -528,12 +594,23 @@ static int traiter_tuile_omp_tiled_collapse(int i_d, int j_d, int i_f, int j_f)
 
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
-	#pragma omp parallel for collapse(2) schedule(static) reduction(|:change)
-	for (int i = i_d; i <= i_f; i++)
-		for (int j = j_d; j <= j_f; j++)
-			change |= compute_new_state(i, j);
+	// Les itérations fusionnées ne se ramènent pas à des lignes : chaque
+	// thread enregistre un événement couvrant toute la tuile
+	#pragma omp parallel reduction(|:change)
+	{
+		monitoring_start_tile();
+
+		#pragma omp for collapse(2) schedule(static) nowait
+		for (int i = i_d; i <= i_f; i++)
+			for (int j = j_d; j <= j_f; j++)
+				change |= compute_new_state(i, j);
+
+		monitoring_end_tile(j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, omp_get_thread_num());
+	}
 		
 
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -575,11 +652,16 @@ static int traiter_tuile_omp_tiled_opt_static(int i_d, int j_d, int i_f, int j_f
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
 	#pragma omp parallel for schedule(static) reduction(|:change)
-	for (int i = i_d; i <= i_f; i++)
+	for (int i = i_d; i <= i_f; i++){
+		monitoring_start_tile();
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
+		monitoring_end_tile(j_d, i, j_f - j_d + 1, 1, omp_get_thread_num());
+	}
 		
 
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -657,11 +739,16 @@ static int traiter_tuile_omp_tiled_opt_cyclic(int i_d, int j_d, int i_f, int j_f
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
 	#pragma omp parallel for schedule(static, 1) reduction(|:change)
-	for (int i = i_d; i <= i_f; i++)
+	for (int i = i_d; i <= i_f; i++){
+		monitoring_start_tile();
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
+		monitoring_end_tile(j_d, i, j_f - j_d + 1, 1, omp_get_thread_num());
+	}
 		
 
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -739,11 +826,16 @@ static int traiter_tuile_omp_tiled_opt_dynamic(int i_d, int j_d, int i_f, int j_
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
 	#pragma omp parallel for schedule(dynamic, 1) reduction(|:change)
-	for (int i = i_d; i <= i_f; i++)
+	for (int i = i_d; i <= i_f; i++){
+		monitoring_start_tile();
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
+		monitoring_end_tile(j_d, i, j_f - j_d + 1, 1, omp_get_thread_num());
+	}
 		
 
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -820,12 +912,23 @@ static int traiter_tuile_omp_tiled_opt_collapse(int i_d, int j_d, int i_f, int j
 
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
-	#pragma omp parallel for collapse(2) schedule(static) reduction(|:change)
-	for (int i = i_d; i <= i_f; i++)
-		for (int j = j_d; j <= j_f; j++)
-			change |= compute_new_state(i, j);
+	// Les itérations fusionnées ne se ramènent pas à des lignes : chaque
+	// thread enregistre un événement couvrant toute la tuile
+	#pragma omp parallel reduction(|:change)
+	{
+		monitoring_start_tile();
+
+		#pragma omp for collapse(2) schedule(static) nowait
+		for (int i = i_d; i <= i_f; i++)
+			for (int j = j_d; j <= j_f; j++)
+				change |= compute_new_state(i, j);
+
+		monitoring_end_tile(j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, omp_get_thread_num());
+	}
 		
 
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
 	return change;
 }
 
@@ -902,10 +1005,14 @@ static int traiter_tuile_task_tiled(int i_d, int j_d, int i_f, int j_f)
 
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
+	monitoring_start_tile();
+
 	for (int i = i_d; i <= i_f; i++)
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
-		
+
+	monitoring_end_tile(j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, omp_get_thread_num());
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
 
 	return change;
 }
@@ -950,10 +1057,14 @@ static int traiter_tuile_task_tiled_opt(int i_d, int j_d, int i_f, int j_f)
 
 	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
 
+	monitoring_start_tile();
+
 	for (int i = i_d; i <= i_f; i++)
 		for (int j = j_d; j <= j_f; j++)
 			change |= compute_new_state(i, j);
-		
+
+	monitoring_end_tile(j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, omp_get_thread_num());
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
 
 	return change;
 }
@@ -1028,6 +1139,284 @@ unsigned vie_compute_task_tiled_opt(unsigned nb_iter)
 }
 
 
+// ============================== Version avec l'ordonnanceur maison ==============================
+
+// Les workers sont lancés une fois pour toutes (init) et arrêtés par
+// finalize ; chaque tuile est confiée au même worker à chaque génération
+// et pour le premier contact (scheduler_place)
+
+static inline void *pack(int i, int j)
+{
+	uint64_t x = (uint64_t)i << 32 | j;
+	return (void *)x;
+}
+
+static inline void unpack(void *a, int *i, int *j)
+{
+	*i = (uint64_t)a >> 32;
+	*j = (uint64_t)a & 0xFFFFFFFF;
+}
+
+// Bornes de la tuile (i, j), sans les bords de l'image
+static inline void tile_bounds(int i, int j, int *i_d, int *j_d, int *i_f, int *j_f)
+{
+	*i_d = (i == 0) + i * tranche;
+	*j_d = (j == 0) + j * tranche;
+	*i_f = (i + 1) * tranche - 1 - (i == GRAIN-1);
+	*j_f = (j + 1) * tranche - 1 - (j == GRAIN-1);
+}
+
+static int traiter_tuile_sched(Uint32 *restrict src, Uint32 *restrict dst, int i, int j, unsigned who)
+{
+	unsigned change = 0;
+	int i_d, j_d, i_f, j_f;
+
+	tile_bounds(i, j, &i_d, &j_d, &i_f, &j_f);
+
+	PRINT_DEBUG('c', "tuile [%d-%d][%d-%d] traitée\n", i_d, i_f, j_d, j_f);
+
+	monitoring_start_tile();
+
+	for (int y = i_d; y <= i_f; y++)
+		for (int x = j_d; x <= j_f; x++)
+			change |= compute_new_state_in(src, dst, y, x);
+
+	monitoring_end_tile(j_d, i_d, j_f - j_d + 1, i_f - i_d + 1, who);
+	graphics_report_tile(i_d, j_d, i_f, j_f, change);
+
+	return change;
+}
+
+void vie_init_sched(void)
+{
+	scheduler_init(-1);
+}
+
+void vie_finalize_sched(void)
+{
+	scheduler_finalize();
+}
+
+static void first_touch_task(void *p, unsigned who)
+{
+	int i, j;
+
+	unpack(p, &i, &j);
+
+	for (int y = i * tranche; y < (i + 1) * tranche; y++){
+		memset(&cur_img(y, j * tranche), 0, tranche * sizeof(Uint32));
+		memset(&next_img(y, j * tranche), 0, tranche * sizeof(Uint32));
+	}
+}
+
+void vie_ft_sched(void)
+{
+	void **params = malloc(GRAIN * GRAIN * sizeof(void *));
+
+	tranche = DIM / GRAIN;
+
+	for (int i = 0; i < GRAIN; i++)
+		for (int j = 0; j < GRAIN; j++)
+			params[i * GRAIN + j] = pack(i, j);
+
+	scheduler_create_tasks(first_touch_task, params, GRAIN * GRAIN);
+	scheduler_task_wait();
+
+	free(params);
+}
+
+// Plusieurs générations sont enchaînées sans barrière : la tuile (i, j) de
+// la génération g lit l'image g % 2 et écrit l'autre, elle attend donc
+// que les 9 tuiles voisines de la génération g-1 aient fini d'écrire ce
+// qu'elle lit (et de lire ce qu'elle écrase)
+//
+// Les générations sont soumises par fenêtres de SWEEP_WINDOW, chacune dans
+// son groupe, avec au plus deux fenêtres en cours : la mémoire reste bornée
+// quel que soit nb_iter, et l'on cesse de soumettre dès qu'une fenêtre
+// terminée contient une génération sans changement.
+
+#define SWEEP_WINDOW 4
+#define SWEEP_RING (2 * SWEEP_WINDOW)
+
+typedef struct
+{
+	unsigned gen;
+	int i, j;
+} sweep_param_t;
+
+static Uint32 *sweep_buf[2];
+static atomic_uint sweep_change[SWEEP_RING];
+
+static void sweep_task(void *p, unsigned who)
+{
+	sweep_param_t *t = p;
+
+	if (traiter_tuile_sched(sweep_buf[t->gen % 2], sweep_buf[(t->gen + 1) % 2], t->i, t->j, who))
+		atomic_store_explicit(&sweep_change[t->gen % SWEEP_RING], 1, memory_order_relaxed);
+}
+
+// Soumet les générations [g_d, g_f) dans group ; prev contient les tâches
+// de la génération g_d - 1 et reçoit celles de la génération g_f - 1
+static void sweep_submit(unsigned g_d, unsigned g_f, task_group_t group, sweep_param_t *params, task_t **prev, task_t **cur)
+{
+	for (unsigned g = g_d; g < g_f; g++){
+		atomic_store(&sweep_change[g % SWEEP_RING], 0);
+
+		for (int i = 0; i < GRAIN; i++){
+			for (int j = 0; j < GRAIN; j++){
+				sweep_param_t *p = &params[((g % SWEEP_RING) * GRAIN + i) * GRAIN + j];
+				task_t deps[9];
+				unsigned n = 0;
+
+				for (int di = -1; di <= 1; di++)
+					for (int dj = -1; dj <= 1; dj++)
+						if (i + di >= 0 && i + di < GRAIN && j + dj >= 0 && j + dj < GRAIN)
+							deps[n++] = (*prev)[(i + di) * GRAIN + j + dj];
+
+				p->gen = g;
+				p->i = i;
+				p->j = j;
+				(*cur)[i * GRAIN + j] = scheduler_submit(sweep_task, p, scheduler_place(i, j, GRAIN, GRAIN), group, deps, n);
+			}
+		}
+
+		task_t *tmp = *prev;
+		*prev = *cur;
+		*cur = tmp;
+	}
+}
+
+unsigned vie_compute_sched(unsigned nb_iter)
+{
+	task_group_t group[2] = {scheduler_group_create(), scheduler_group_create()};
+	sweep_param_t *params = malloc(SWEEP_RING * GRAIN * GRAIN * sizeof(sweep_param_t));
+	task_t *prev = calloc(GRAIN * GRAIN, sizeof(task_t));
+	task_t *cur = malloc(GRAIN * GRAIN * sizeof(task_t));
+	unsigned submitted = 0, checked = 0, stable = 0;
+
+	tranche = DIM / GRAIN;
+	sweep_buf[0] = image;
+	sweep_buf[1] = alt_image;
+
+	while (checked < nb_iter && !stable){
+		// Une fenêtre d'avance : les workers ne manquent pas de travail
+		// pendant qu'on examine la plus ancienne
+		while (submitted < nb_iter && submitted < checked + 2 * SWEEP_WINDOW){
+			unsigned g_f = MIN(submitted + SWEEP_WINDOW, nb_iter);
+
+			sweep_submit(submitted, g_f, group[(submitted / SWEEP_WINDOW) % 2], params, &prev, &cur);
+			submitted = g_f;
+		}
+
+		unsigned g_f = MIN(checked + SWEEP_WINDOW, nb_iter);
+
+		scheduler_group_wait(group[(checked / SWEEP_WINDOW) % 2]);
+
+		// Comme la version séquentielle : arrêt à la première génération
+		// sans changement (les suivantes déjà soumises ne modifient rien)
+		for (unsigned g = checked; g < g_f; g++){
+			swap_images();
+			if (!atomic_load(&sweep_change[g % SWEEP_RING])){
+				stable = g + 1;
+				break;
+			}
+		}
+		checked = g_f;
+	}
+
+	scheduler_group_destroy(group[0]);
+	scheduler_group_destroy(group[1]);
+
+	free(cur);
+	free(prev);
+	free(params);
+
+	return stable;
+}
+
+// ============================== Version avec l'ordonnanceur maison, tuiles modifiées seulement ==============================
+
+// Une tuile dont ni elle ni ses voisines n'ont changé à la génération
+// précédente ne change pas : elle n'est pas soumise. L'autre image contient
+// alors déjà son état, identique à celui de la génération précédente.
+
+static unsigned char *tile_changed = NULL, *tile_next = NULL;
+
+static void lazy_task(void *p, unsigned who)
+{
+	int i, j;
+
+	unpack(p, &i, &j);
+
+	tile_next[i * GRAIN + j] = traiter_tuile_sched(image, alt_image, i, j, who);
+}
+
+void vie_init_sched_lazy(void)
+{
+	vie_init_sched();
+}
+
+void vie_ft_sched_lazy(void)
+{
+	vie_ft_sched();
+}
+
+void vie_finalize_sched_lazy(void)
+{
+	vie_finalize_sched();
+	free(tile_changed);
+	free(tile_next);
+}
+
+static bool tile_dirty(int i, int j)
+{
+	for (int di = -1; di <= 1; di++)
+		for (int dj = -1; dj <= 1; dj++)
+			if (i + di >= 0 && i + di < GRAIN && j + dj >= 0 && j + dj < GRAIN && tile_changed[(i + di) * GRAIN + j + dj])
+				return true;
+	return false;
+}
+
+unsigned vie_compute_sched_lazy(unsigned nb_iter)
+{
+	tranche = DIM / GRAIN;
+
+	// Premier appel : toutes les tuiles sont à calculer
+	if (tile_changed == NULL){
+		tile_changed = malloc(GRAIN * GRAIN);
+		tile_next = malloc(GRAIN * GRAIN);
+		memset(tile_changed, 1, GRAIN * GRAIN);
+	}
+
+	for (unsigned it = 1; it <= nb_iter; it++){
+		unsigned change = 0;
+
+		memset(tile_next, 0, GRAIN * GRAIN);
+
+		for (int i = 0; i < GRAIN; i++)
+			for (int j = 0; j < GRAIN; j++)
+				if (tile_dirty(i, j))
+					scheduler_create_task(lazy_task, pack(i, j), scheduler_place(i, j, GRAIN, GRAIN));
+
+		scheduler_task_wait();
+
+		for (int t = 0; t < GRAIN * GRAIN; t++)
+			change |= tile_next[t];
+
+		unsigned char *tmp = tile_changed;
+		tile_changed = tile_next;
+		tile_next = tmp;
+
+		swap_images();
+
+		if (!change)
+			return it;
+	}
+
+	return 0;
+}
+
+
 // ============================== Version OpenCL tuilée ==============================
 
 unsigned vie_compute_ocl (unsigned nb_iter)